@@ -0,0 +1,43 @@
+#ifndef AUTO_EXPOSURE_H
+#define AUTO_EXPOSURE_H
+
+#include <vector>
+#include <glad/glad.h>
+
+/*
+  Exposure for the HDR accumulation target. Every few frames the target is
+  reduced on the GPU (mipmapped down to ~64 px) and read back later through a
+  pixel buffer so it never stalls. A histogram of the log luminance of the lit
+  pixels picks the exposure, which is eased towards every frame.
+*/
+class AutoExposure
+{
+    private:
+        static const int num_pbos = 2;
+
+        GLuint m_pbos[num_pbos];
+        GLsync m_fences[num_pbos];
+        int m_sizes[num_pbos][2];
+        float m_scales[num_pbos];
+        int m_next;
+        unsigned int m_frame;
+        float m_exposure;
+        float m_target_exposure;
+        std::vector<float> m_pixels;
+
+        bool read(int pbo);
+
+    public:
+        AutoExposure();
+        ~AutoExposure();
+
+        AutoExposure(AutoExposure const &) = delete;
+        AutoExposure& operator=(AutoExposure const &) = delete;
+
+        // Call after the target is drawn, returns the smoothed exposure.
+        // scale is how much the stored values are multiplied by when presented
+        float update(GLuint texture, int width, int height, float scale = 1.0f);
+        float exposure() const { return m_exposure; }
+};
+
+#endif
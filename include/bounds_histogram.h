@@ -0,0 +1,45 @@
+#ifndef BOUNDS_HISTOGRAM_H
+#define BOUNDS_HISTOGRAM_H
+
+#include <vector>
+#include <cstdint>
+
+/*
+  Per-axis fixed-bin histogram of plotted points, used to find robust
+  (percentile) bounds. Points are counted into the current frame with add(),
+  and folded into the decaying totals once per frame with commit().
+*/
+class BoundsHistogram
+{
+    private:
+        float m_range;
+        float m_bin_scale;
+        int m_bins;
+        std::vector<uint32_t> m_frame_x, m_frame_y;
+        std::vector<double> m_x, m_y;
+        double m_total;
+
+        float quantile(std::vector<double> const & counts, double q) const;
+
+    public:
+        BoundsHistogram(float range = 4.0f, int bins = 1024);
+
+        // Points outside [-range, range] (or NaN) are not counted
+        void add(float x, float y) {
+            const float bx = (x + m_range) * m_bin_scale;
+            const float by = (y + m_range) * m_bin_scale;
+            if (bx >= 0.0f && by >= 0.0f && bx < float(m_bins) && by < float(m_bins)) {
+                m_frame_x[int(bx)] += 1;
+                m_frame_y[int(by)] += 1;
+            }
+        }
+
+        void commit(double decay = 1.0);
+        void clear();
+        double total() const { return m_total; }
+
+        bool bounds(double lo_q, double hi_q,
+                    float& min_x, float& max_x, float& min_y, float& max_y) const;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef CHECKPOINT_INDEX_H
+#define CHECKPOINT_INDEX_H
+
+#include <string>
+#include <vector>
+#include <future>
+#include <glm/glm.hpp>
+
+/* Everything the stepper needs to carry on from the end of a frame */
+struct Checkpoint
+{
+    double t;
+    double rolling_delta;
+    float plot_scale;
+    float plot_x;
+    float plot_y;
+    std::vector<glm::vec2> history;
+};
+
+/*
+  Checkpoints of one equation's sweep, ordered by t. Indexes of equations
+  marked with keep() are written to "<dir>/<code>.chk" (on a worker thread)
+  so they survive restarts.
+*/
+class CheckpointIndex
+{
+    private:
+        std::string m_dir;
+        std::string m_code;
+        std::vector<Checkpoint> m_checkpoints;
+        bool m_dirty;
+        bool m_keep;
+        std::future<void> m_writing;
+
+        std::string path() const { return m_dir + "/" + m_code + ".chk"; }
+
+    public:
+        CheckpointIndex(std::string const & dir) : m_dir(dir), m_dirty(false), m_keep(false) {}
+        ~CheckpointIndex();
+
+        void open(std::string const & code);
+        // Only kept equations are saved, not every one shown in passing
+        void keep() { m_keep = true; }
+        void save();
+
+        // Only extends the index, earlier t are already covered
+        void record(Checkpoint&& checkpoint);
+
+        bool empty() const { return m_checkpoints.empty(); }
+        double max_t() const { return m_checkpoints.empty() ? -1e300 : m_checkpoints.back().t; }
+
+        // Latest checkpoint at or before t (or the first one)
+        Checkpoint const * find(double t) const;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef DENSITY_BINNER_H
+#define DENSITY_BINNER_H
+
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "worker_pool.h"
+#include "vertex_types.h"
+
+/*
+  Alternative to drawing one pixel points: the frame's points are binned
+  on the CPU into a screen sized buffer of (colour * alpha, alpha) sums, and
+  the rectangle they touched is uploaded as a half float texture for the
+  trail pass to composite. At 8 bytes a bin against 4 a point, that only
+  uploads less once about two points land on each pixel.
+
+  Binning runs in two phases on the pool's threads. Each thread takes a
+  slice of the points and sorts them into per-tile lists (a tile being a
+  band of rows), then each thread merges every list for its own tile into
+  the sums, so no two threads ever write the same pixel.
+*/
+class DensityBinner
+{
+    private:
+        struct BinnedPoint {
+            uint32_t pixel;
+            uint32_t colour;
+        };
+
+        int m_threads;
+        WorkerPool m_pool;
+        int m_width;
+        int m_height;
+        GLuint m_texture;
+        int m_texture_size[2];
+        std::vector<float> m_palette;
+        std::vector<float> m_sums;
+        std::vector<uint16_t> m_upload;
+        // m_tiles[thread][tile]
+        std::vector<std::vector<std::vector<BinnedPoint>>> m_tiles;
+        // Rows touched per tile, [min, max)
+        std::vector<int> m_tile_rows;
+        // Columns touched per thread, [min, max)
+        std::vector<int> m_thread_cols;
+        size_t m_binned;
+        size_t m_upload_bytes;
+
+        int tile_start(int tile) const { return int(int64_t(m_height) * tile / m_threads); }
+
+        void sort_points(int thread, const VertexPos* pos, size_t count,
+                         const glm::vec4& quant, const glm::vec4& view);
+        void merge_tile(int tile);
+
+    public:
+        // threads = 0 uses the hardware concurrency
+        DensityBinner(int threads = 0);
+        ~DensityBinner();
+
+        DensityBinner(DensityBinner const &) = delete;
+        DensityBinner& operator=(DensityBinner const &) = delete;
+
+        void resize(int width, int height);
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+
+        // One colour per iteration, points are laid out step by step
+        void set_palette(const VertexColour* palette, int count);
+
+        // Same packing and transforms as the point shader
+        void bin(const VertexPos* pos, size_t count, const glm::vec4& quant, const glm::vec4& view);
+        // Uploads the touched rectangle, returns false if nothing was binned
+        bool upload();
+
+        GLuint texture() const { return m_texture; }
+        size_t binned() const { return m_binned; }
+        // Bytes sent by the last upload()
+        size_t upload_bytes() const { return m_upload_bytes; }
+        // Rows and columns holding this frame's points, [min, max)
+        int min_row() const;
+        int max_row() const;
+        int min_col() const;
+        int max_col() const;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef FRAME_STORE_H
+#define FRAME_STORE_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+/*
+  One frame of orbit points in world space. Points are quantized to 16 bits
+  over [-FRAME_RANGE, FRAME_RANGE] and delta coded (zigzag varints) against
+  the previous step of the same iteration. Points outside that range are
+  stored as runs of hidden points. Every frame decodes on its own.
+*/
+#define FRAME_RANGE 8.0
+
+struct PackedFrame
+{
+    double t;
+    double rolling_delta;
+    std::vector<uint8_t> data;
+};
+
+/* A frame finished by the encoder, with where it should go */
+struct EncodedFrame
+{
+    PackedFrame frame;
+    std::vector<glm::vec2> history;
+    bool cache;
+    bool ring;
+};
+
+/*
+  push() only quantizes the points on the calling thread, the delta coding
+  of a submitted frame runs on the encoder's own thread. Finished frames come
+  back from collect() in the order they were submitted.
+*/
+class FrameEncoder
+{
+    private:
+        struct Job
+        {
+            std::vector<int16_t> raw;
+            EncodedFrame out;
+        };
+
+        int m_iters;
+        std::vector<int16_t> m_raw;
+        std::vector<std::vector<int16_t>> m_spare;
+        std::deque<Job> m_queue;
+        std::deque<EncodedFrame> m_done;
+        size_t m_pending;
+        unsigned int m_generation;
+        bool m_stop;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_finished;
+        std::thread m_thread;
+
+        void work();
+
+    public:
+        FrameEncoder(int iters);
+        ~FrameEncoder();
+        FrameEncoder(const FrameEncoder&) = delete;
+        FrameEncoder& operator=(const FrameEncoder&) = delete;
+
+        void begin();
+        void push(double x, double y);
+        // Queue the frame for encoding (waits if the encoder has fallen behind)
+        void submit(double t, double rolling_delta, std::vector<glm::vec2> const & history, bool cache, bool ring);
+        // Next finished frame, waiting for the ones in flight if asked
+        bool collect(EncodedFrame& frame, bool wait);
+        // Drop every frame not collected yet
+        void discard();
+};
+
+// Hidden points decode to NaN
+void UnpackFrame(PackedFrame const & frame, int iters, std::vector<glm::vec2>& points);
+
+/* Every frame of one pass over t, up to a memory budget */
+class SweepCache
+{
+    private:
+        std::vector<PackedFrame> m_frames;
+        std::vector<glm::vec2> m_resume_history;
+        size_t m_bytes;
+        size_t m_budget;
+        bool m_complete;
+
+    public:
+        SweepCache(size_t budget) : m_bytes(0), m_budget(budget), m_complete(false) {}
+
+        void clear();
+        bool add(PackedFrame&& frame, std::vector<glm::vec2> const & history);
+        void finish() { m_complete = true; }
+
+        bool empty() const { return m_frames.empty(); }
+        bool complete() const { return m_complete; }
+        size_t size() const { return m_frames.size(); }
+        size_t bytes() const { return m_bytes; }
+        PackedFrame const & frame(size_t i) const { return m_frames[i]; }
+        // First frame ending at or after t (size() if none)
+        size_t seek(double t) const;
+        std::vector<glm::vec2> const & resume_history() const { return m_resume_history; }
+};
+
+/* The most recent frames up to a memory budget, newest at age 0 */
+class FrameRing
+{
+    private:
+        std::deque<PackedFrame> m_frames;
+        size_t m_bytes;
+        size_t m_budget;
+
+    public:
+        FrameRing(size_t budget) : m_bytes(0), m_budget(budget) {}
+
+        void clear() { m_frames.clear(); m_bytes = 0; }
+        void push(PackedFrame&& frame);
+
+        bool empty() const { return m_frames.empty(); }
+        size_t size() const { return m_frames.size(); }
+        PackedFrame const & at_age(size_t age) const { return m_frames[m_frames.size() - 1 - age]; }
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <glad/glad.h>
+
+/*
+  The glad loader only covers GL 3.3 core, newer entry points we can use
+  when the driver has them are loaded here by hand.
+*/
+
+// ARB_buffer_storage (core in 4.4)
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+// KHR_parallel_shader_compile (or the ARB one)
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+struct GLExtensions
+{
+    bool buffer_storage;
+    PFNGLBUFFERSTORAGEPROC BufferStorage;
+
+    bool program_binary;
+    PFNGLGETPROGRAMBINARYPROC GetProgramBinary;
+    PFNGLPROGRAMBINARYPROC ProgramBinary;
+    PFNGLPROGRAMPARAMETERIPROC ProgramParameteri;
+
+    bool parallel_shader_compile;
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC MaxShaderCompilerThreads;
+};
+
+extern GLExtensions gl_ext;
+
+// Call with a current context, after gladLoadGLLoader
+void LoadGLExtensions(GLADloadproc load);
+bool HasGLExtension(char const * name);
+
+#endif
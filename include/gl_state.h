@@ -0,0 +1,98 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <cstdint>
+#include <glad/glad.h>
+
+/*
+  Shadow copy of the GL state we change per frame. Binds and enables that
+  would not change anything are skipped, and state queries are answered
+  from the copy rather than glGet* (which can stall the driver). Every
+  change to tracked state has to go through here; state it doesn't track
+  is passed straight to GL.
+*/
+class GLStateCache
+{
+    public:
+        static const int num_units = 8;
+
+        struct Counters {
+            uint64_t issued;
+            uint64_t skipped;
+            uint64_t queries;
+        };
+
+    private:
+        static const int num_caps = 11;
+
+        GLuint m_program;
+        GLuint m_vertex_array;
+        GLuint m_array_buffer;
+        GLenum m_active_texture;
+        GLuint m_textures[num_units];
+        GLuint m_samplers[num_units];
+        GLuint m_draw_framebuffer;
+        GLuint m_read_framebuffer;
+        bool m_caps[num_caps];
+        GLenum m_blend_func[4];
+        GLenum m_blend_equation[2];
+        GLint m_viewport[4];
+        GLint m_scissor[4];
+        GLenum m_polygon_mode;
+        Counters m_counters;
+
+        bool changed(bool change) {
+            if (change) m_counters.issued += 1; else m_counters.skipped += 1;
+            return change;
+        }
+
+    public:
+        GLStateCache();
+
+        // Reads the tracked state back from GL, call once the context is current
+        void sync();
+
+        void use_program(GLuint program);
+        void bind_vertex_array(GLuint vertex_array);
+        void bind_buffer(GLenum target, GLuint buffer);
+        void active_texture(GLenum unit);
+        void bind_texture(GLenum target, GLuint texture);
+        void bind_sampler(GLuint unit, GLuint sampler);
+        void bind_framebuffer(GLenum target, GLuint framebuffer);
+        void set_enabled(GLenum cap, bool enabled);
+        void enable(GLenum cap) { set_enabled(cap, true); }
+        void disable(GLenum cap) { set_enabled(cap, false); }
+        void blend_func(GLenum src, GLenum dst) { blend_func_separate(src, dst, src, dst); }
+        void blend_func_separate(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha);
+        void blend_equation(GLenum mode) { blend_equation_separate(mode, mode); }
+        void blend_equation_separate(GLenum mode_rgb, GLenum mode_alpha);
+        void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+        void scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+        void polygon_mode(GLenum mode);
+
+        GLuint program() { m_counters.queries += 1; return m_program; }
+        GLuint vertex_array() { m_counters.queries += 1; return m_vertex_array; }
+        GLuint array_buffer() { m_counters.queries += 1; return m_array_buffer; }
+        GLenum active_texture() { m_counters.queries += 1; return m_active_texture; }
+        // 2D texture bound to the active unit
+        GLuint texture() { m_counters.queries += 1; return m_textures[m_active_texture - GL_TEXTURE0]; }
+        GLuint sampler(GLuint unit) { m_counters.queries += 1; return m_samplers[unit]; }
+        GLuint draw_framebuffer() { m_counters.queries += 1; return m_draw_framebuffer; }
+        GLuint read_framebuffer() { m_counters.queries += 1; return m_read_framebuffer; }
+        bool is_enabled(GLenum cap);
+        // src rgb, dst rgb, src alpha, dst alpha
+        void get_blend_func(GLenum* func) { m_counters.queries += 1; for (int i = 0; i < 4; ++i) func[i] = m_blend_func[i]; }
+        // rgb, alpha
+        void get_blend_equation(GLenum* mode) { m_counters.queries += 1; mode[0] = m_blend_equation[0]; mode[1] = m_blend_equation[1]; }
+        void get_viewport(GLint* box) { m_counters.queries += 1; for (int i = 0; i < 4; ++i) box[i] = m_viewport[i]; }
+        void get_scissor(GLint* box) { m_counters.queries += 1; for (int i = 0; i < 4; ++i) box[i] = m_scissor[i]; }
+        GLenum polygon_mode() { m_counters.queries += 1; return m_polygon_mode; }
+
+        // Calls made, calls skipped and queries answered, since the last reset
+        const Counters& counters() const { return m_counters; }
+        void reset_counters() { m_counters = Counters{}; }
+};
+
+extern GLStateCache gl_state;
+
+#endif
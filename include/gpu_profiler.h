@@ -0,0 +1,74 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <glad/glad.h>
+
+struct GpuPassStats {
+    std::string name;
+    size_t samples;
+    double average;
+    double p50, p95, p99;
+};
+
+/*
+  GPU time per render pass from GL_TIME_ELAPSED queries. Each pass has a
+  small ring of query objects (one per frame in flight), and results are
+  collected a few frames later only if already available, so the profiler
+  never waits on the GPU. Passes cannot nest.
+*/
+class GpuProfiler
+{
+    private:
+        static const int num_frames = 4;
+
+        struct Pass {
+            std::string name;
+            GLuint queries[num_frames];
+            bool pending[num_frames];
+            std::vector<double> history;
+            size_t next;
+        };
+
+        std::vector<Pass> m_passes;
+        size_t m_history;
+        bool m_enabled;
+        int m_active;
+        int m_slot;
+        uint64_t m_frame;
+        uint64_t m_slot_frames[num_frames];
+        double m_collected_ms;
+        bool m_collected;
+        std::ofstream m_csv;
+
+        bool collect(Pass& pass, int slot);
+
+    public:
+        GpuProfiler(size_t history = 240);
+        ~GpuProfiler();
+
+        GpuProfiler(GpuProfiler const &) = delete;
+        GpuProfiler& operator=(GpuProfiler const &) = delete;
+
+        // Each collected sample is also written as a "frame,pass,ms" row
+        bool open_csv(const std::string& path);
+
+        void set_enabled(bool enabled) { m_enabled = enabled; }
+        bool enabled() const { return m_enabled; }
+
+        void begin(const char* name);
+        void end();
+        // Once per frame, collects whatever has landed from older frames
+        void next_frame();
+
+        // Total of the passes collected by the last next_frame(), false if none were
+        bool last_frame_ms(double& ms) const { ms = m_collected_ms; return m_collected; }
+
+        // Rolling stats over the recent samples, in milliseconds
+        std::vector<GpuPassStats> stats() const;
+};
+
+#endif
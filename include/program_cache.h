@@ -0,0 +1,50 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <string>
+#include <cstdint>
+#include <initializer_list>
+#include <glad/glad.h>
+
+/*
+  On-disk cache of linked program binaries (ARB_get_program_binary), one
+  "<dir>/<key>.bin" per program. Keys hash the shader sources, the program
+  configuration and the driver (vendor, renderer, version), so an edited
+  shader or a driver update just misses. Files that don't match their key
+  or checksum, or that the driver rejects, are recompiled and rewritten.
+*/
+class ProgramCache
+{
+    private:
+        std::string m_dir;
+        std::string m_driver;
+        bool m_enabled;
+        int m_hits;
+        int m_misses;
+
+        std::string path(uint64_t key) const;
+
+    public:
+        ProgramCache() : m_enabled(false), m_hits(0), m_misses(0) {}
+
+        // Call with a current context, after LoadGLExtensions. Stays disabled
+        // when the driver can't hand out program binaries
+        void open(std::string const & dir);
+        bool enabled() const { return m_enabled; }
+
+        int hits() const { return m_hits; }
+        int misses() const { return m_misses; }
+
+        // Sources go in by hash (HashShaderSource), in stage order
+        uint64_t key(std::initializer_list<uint64_t> source_hashes, std::string const & config) const;
+
+        // Call before linking a program that will be stored
+        void prepare(GLuint program) const;
+        // Links the program from its cached binary, false on a miss
+        bool load(GLuint program, uint64_t key);
+        void store(GLuint program, uint64_t key) const;
+};
+
+extern ProgramCache program_cache;
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef RESOLUTION_SCALER_H
+#define RESOLUTION_SCALER_H
+
+/*
+  Picks the trail target's resolution scale to hold a GPU frame time
+  budget. Frame times are averaged over a window of frames, then the scale
+  steps one level down if over budget, or up (above 1.0 for supersampling)
+  if the predicted time at the next level still fits comfortably.
+*/
+class ResolutionScaler
+{
+    private:
+        double m_budget_ms;
+        int m_level;
+        double m_total_ms;
+        int m_frames;
+
+    public:
+        // A budget of 0 disables scaling (the scale stays at 1)
+        ResolutionScaler(double budget_ms = 0.0);
+
+        bool enabled() const { return m_budget_ms > 0.0; }
+
+        // GPU time of one frame, returns true if the scale changed
+        bool add_frame(double gpu_ms);
+        float scale() const;
+};
+
+#endif
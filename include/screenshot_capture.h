@@ -0,0 +1,70 @@
+#ifndef SCREENSHOT_CAPTURE_H
+#define SCREENSHOT_CAPTURE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <glad/glad.h>
+
+/*
+  Screenshots that never stall the frame. The read framebuffer is copied
+  into one of a small ring of pixel buffers, which is only mapped once its
+  fence has signalled (a frame or two later). PNG encoding and the file
+  write happen on a background thread. Files are named
+  "<dir>/<date>-<time>-<ms>_<tag>.png".
+*/
+class ScreenshotCapture
+{
+    private:
+        static const int num_pbos = 3;
+
+        struct Slot {
+            GLuint pbo;
+            GLsync fence;
+            int width;
+            int height;
+            GLsizeiptr capacity;
+            std::string path;
+        };
+
+        struct Image {
+            std::string path;
+            int width;
+            int height;
+            std::vector<uint8_t> rgba;
+        };
+
+        std::string m_dir;
+        Slot m_slots[num_pbos];
+        int m_next;
+
+        std::thread m_writer;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::deque<Image> m_images;
+        bool m_stop;
+
+        bool read(Slot& slot, bool wait);
+        void write_images();
+
+    public:
+        ScreenshotCapture(std::string const & dir);
+        ~ScreenshotCapture();
+
+        ScreenshotCapture(ScreenshotCapture const &) = delete;
+        ScreenshotCapture& operator=(ScreenshotCapture const &) = delete;
+
+        // Starts reading the bottom left width x height of the read framebuffer.
+        // False if every pixel buffer is still in flight
+        bool capture(int width, int height, std::string const & tag);
+        // Once per frame, hands the captures that have landed to the writer
+        void poll();
+        // Captures not yet handed to the writer
+        int in_flight() const;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef SESSION_LOG_H
+#define SESSION_LOG_H
+
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include "checkpoint_index.h"
+
+/*
+  Binary log of everything that steers a session: the seed, the window
+  size, the sweep cache budget, and then per frame the inputs that were applied before it was
+  stepped (key presses, resizes, seeks, mouse pans/zooms, the equation in
+  use) followed by the frame's speed. Codes typed at the 'L' prompt follow
+  the frame they were entered in. Seeks carry the checkpoint they resumed
+  from, so a replay does not depend on the checkpoint files on disk.
+*/
+enum class SessionEvent : uint8_t
+{
+    Frame = 0,
+    Key = 1,
+    Resize = 2,
+    Load = 3,
+    Equation = 4,
+    Seek = 5,
+    View = 6,
+};
+
+struct SessionRecord
+{
+    SessionEvent type;
+    int key;
+    int width;
+    int height;
+    double value;
+    float view[3];
+    std::string code;
+    bool has_checkpoint;
+    Checkpoint checkpoint;
+};
+
+class SessionRecorder
+{
+    private:
+        std::ofstream m_out;
+
+        void event(SessionEvent type) { m_out.put(char(type)); }
+        void code(std::string const & code);
+
+    public:
+        bool open(std::string const & path, uint32_t seed, int width, int height, size_t sweep_cache_mb);
+        bool is_open() const { return m_out.is_open(); }
+
+        void frame(double speed_mult);
+        void key(int key);
+        void resize(int width, int height);
+        void load(std::string const & code);
+        void equation(std::string const & code);
+        // The checkpoint is null if the seek did not resume from one
+        void seek(double t, Checkpoint const * checkpoint);
+        void view(float scale, float x, float y);
+};
+
+class SessionPlayer
+{
+    private:
+        std::ifstream m_in;
+        uint32_t m_seed;
+        int m_width;
+        int m_height;
+        size_t m_sweep_cache_mb;
+
+    public:
+        bool open(std::string const & path);
+        bool is_open() const { return m_in.is_open(); }
+
+        uint32_t seed() const { return m_seed; }
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+        size_t sweep_cache_mb() const { return m_sweep_cache_mb; }
+
+        // False at the end of the log
+        bool next(SessionRecord& record);
+};
+
+#endif
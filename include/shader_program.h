@@ -2,13 +2,17 @@
 #define SHADER_PROGRAM_H
 
 #include <string>
+#include <vector>
+#include <iostream>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "gl_state.h"
+#include "shader_source.h"
 
 #define _BASIC_UNIFORM_SETTER(ctype, type_suffix) \
     void uniform ## type_suffix (std::string const & key, std::initializer_list<ctype> &&values) {                       \
-        GLuint location = glGetUniformLocation(m_program_id, key.c_str());                                               \
+        GLint location = uniform_location(key);                                                                          \
         const ctype * values_ptr = values.begin();                                                                       \
         switch (values.size())                                                                                           \
         {                                                                                                                \
@@ -27,29 +31,148 @@
     }
 #define BASIC_UNIFORM_SETTER(ctype, type_suffix) _BASIC_UNIFORM_SETTER(ctype, type_suffix)
 
+/* How each C type maps onto the GL uniform types it may set */
+template<typename T> struct UniformTraits;
+
+template<> struct UniformTraits<GLfloat> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT; }
+    static void set(GLint location, GLsizei count, GLfloat const * values) { glUniform1fv(location, count, values); }
+};
+
+template<> struct UniformTraits<GLint> {
+    static bool accepts(GLenum type) {
+      return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_1D || type == GL_SAMPLER_2D ||
+             type == GL_SAMPLER_3D || type == GL_SAMPLER_2D_ARRAY || type == GL_SAMPLER_BUFFER ||
+             type == GL_INT_SAMPLER_2D || type == GL_UNSIGNED_INT_SAMPLER_2D;
+    }
+    static void set(GLint location, GLsizei count, GLint const * values) { glUniform1iv(location, count, values); }
+};
+
+template<> struct UniformTraits<GLuint> {
+    static bool accepts(GLenum type) { return type == GL_UNSIGNED_INT; }
+    static void set(GLint location, GLsizei count, GLuint const * values) { glUniform1uiv(location, count, values); }
+};
+
+template<> struct UniformTraits<glm::vec4> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_VEC4; }
+    static void set(GLint location, GLsizei count, glm::vec4 const * values) {
+      glUniform4fv(location, count, glm::value_ptr(values[0]));
+    }
+};
+
+template<> struct UniformTraits<glm::mat4> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_MAT4; }
+    static void set(GLint location, GLsizei count, glm::mat4 const * values) {
+      glUniformMatrix4fv(location, count, GL_FALSE, glm::value_ptr(values[0]));
+    }
+};
+
+/*
+  A uniform resolved when the program was linked, so setting it is a single
+  glUniform call. Uniforms the linker dropped have location -1, which GL
+  ignores. The program has to be in use.
+*/
+template<typename T>
+class Uniform
+{
+    private:
+        GLint m_location;
+
+    public:
+        Uniform(GLint location = -1) : m_location(location) {}
+
+        GLint location() const { return m_location; }
+        bool active() const { return m_location >= 0; }
+
+        void set(T const & value) const { UniformTraits<T>::set(m_location, 1, &value); }
+        void set(T const * values, GLsizei count) const { UniformTraits<T>::set(m_location, count, values); }
+};
+
 class ShaderProgram
 {
     private:
+        /* Active uniforms outside blocks and uniform blocks, sorted by name (arrays without the [0]) */
+        struct ActiveUniform {
+            std::string name;
+            GLint location;
+            GLenum type;
+            GLint size;
+        };
+        struct ActiveBlock {
+            std::string name;
+            GLuint index;
+            GLint data_size;
+        };
+
         GLint m_program_id;
+        GLuint m_vertex_shader, m_frag_shader, m_geom_shader;
+        uint64_t m_cache_key;
+        bool m_pending;
+        std::vector<ActiveUniform> m_uniforms;
+        std::vector<ActiveBlock> m_blocks;
+
+        void build(std::string const & vertex_shader, uint64_t vertex_hash,
+                   std::string const & frag_shader, uint64_t frag_hash,
+                   std::string const & geom_shader, uint64_t geom_hash);
+        void reflect();
+        ActiveUniform const * find_uniform(std::string const & name) const;
 
     public:
         ShaderProgram(
             std::string vertex_shader_path,
             std::string frag_shader_path,
             std::string geom_shader_path = nullptr);
-        ~ShaderProgram() { glDeleteProgram(m_program_id); }
+        /* From shaders embedded at build time (see shader_source.h) */
+        ShaderProgram(
+            ShaderSource const & vertex_source,
+            ShaderSource const & frag_source,
+            ShaderSource const * geom_source = nullptr);
+        ~ShaderProgram() { finish(); glDeleteProgram(m_program_id); }
+
+        /* Waits for the compile and link started by the constructor, and checks them.
+           Using the program or looking up uniforms or blocks does this first */
+        void finish();
 
         GLint get_prog_id() const { return m_program_id; }
-        void use() const { glUseProgram(m_program_id); };
+        void use() { finish(); gl_state.use_program(m_program_id); };
+
+        /* Looks the uniform up in the reflected table (no driver call), -1 if not active */
+        GLint uniform_location(std::string const & key);
+
+        /* Typed handle to set a uniform from the render loop, resolve once up front */
+        template<typename T>
+        Uniform<T> uniform(std::string const & key) {
+          finish();
+          ActiveUniform const * active = find_uniform(key);
+          if (!active) {
+            return Uniform<T>();
+          }
+          if (!UniformTraits<T>::accepts(active->type)) {
+            std::cerr << "SHADER_PROGRAM::UNIFORM_TYPE_MISMATCH " << key << '\n';
+            return Uniform<T>();
+          }
+          return Uniform<T>(active->location);
+        }
+
+        /* Attaches a uniform block to a buffer binding point, false if the program has no such block.
+           Warns when the block needs more than expected_size bytes (the C++ side of its std140 layout) */
+        bool bind_uniform_block(std::string const & name, GLuint binding, GLint expected_size = 0);
 
         BASIC_UNIFORM_SETTER(GLfloat, f)
         BASIC_UNIFORM_SETTER(GLint, i)
         BASIC_UNIFORM_SETTER(GLuint, ui)
 
         void uniformMat4f(std::string const & key, glm::mat4 const & mat) {
-          GLuint location = glGetUniformLocation(m_program_id, key.c_str());
-          glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
+          uniform<glm::mat4>(key).set(mat);
+        }
+
+        void uniformVec4fv(std::string const & key, GLsizei count, glm::vec4 const * values) {
+          uniform<glm::vec4>(key).set(values, count);
         }
 };
 
+/* Embedded shaders are read from this directory instead when it has a file
+   of the same name, to edit them without rebuilding */
+void SetShaderOverrideDir(std::string const & dir);
+
 #endif
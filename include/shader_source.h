@@ -0,0 +1,32 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <cstdint>
+#include <string_view>
+
+/* FNV-1a of a shader's text */
+constexpr uint64_t HashShaderSource(std::string_view source) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char c : source) {
+    hash = (hash ^ uint64_t(static_cast<unsigned char>(c))) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+/*
+  A shader compiled into the binary. The makefile turns every
+  shaders/<name>.glsl into temp/<name>.glsl.h, which defines <name>_glsl
+  as one of these, hashed at compile time. Lines #include "<file>" are
+  replaced by shaders/include/<file> on the way.
+*/
+struct ShaderSource
+{
+    char const * name;      // File name under shaders/
+    std::string_view code;
+    uint64_t hash;
+
+    constexpr ShaderSource(char const * name, std::string_view code)
+      : name(name), code(code), hash(HashShaderSource(code)) {}
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef STARTUP_PROFILER_H
+#define STARTUP_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <ostream>
+
+/*
+  Wall clock time of each startup phase, from when the profiler was made to
+  the first presented frame. Phases may run on worker threads and overlap
+  the main thread, so each keeps its own start and end. Thread safe.
+*/
+class StartupProfiler
+{
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Phase {
+            std::string name;
+            double start_ms;
+            double end_ms;
+            bool worker;
+        };
+
+        Clock::time_point m_origin;
+        std::thread::id m_main_thread;
+        mutable std::mutex m_mutex;
+        std::vector<Phase> m_phases;
+        double m_first_frame_ms;
+
+        double now_ms() const;
+
+    public:
+        StartupProfiler();
+
+        // Returns the phase to pass to end()
+        int begin(std::string const & name);
+        void end(int phase);
+
+        void first_frame();
+        bool done() const { return m_first_frame_ms >= 0.0; }
+        double first_frame_ms() const { return m_first_frame_ms; }
+
+        void report(std::ostream& out) const;
+};
+
+#endif
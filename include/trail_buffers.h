@@ -0,0 +1,50 @@
+#ifndef TRAIL_BUFFERS_H
+#define TRAIL_BUFFERS_H
+
+#include <glad/glad.h>
+
+/*
+  Two offscreen trail targets used alternately, so the fade pass reads last
+  frame's image from one while drawing this frame into the other (instead of
+  sampling the texture it is rendering to). In HDR mode they are RGBA32F
+  for additive accumulation (half floats overflow on dense pixels).
+*/
+class TrailBuffers
+{
+    private:
+        GLuint m_framebuffers[2];
+        GLuint m_textures[2];
+        int m_current;
+        int m_width;
+        int m_height;
+        bool m_hdr;
+
+    public:
+        TrailBuffers(int width, int height);
+        ~TrailBuffers();
+
+        TrailBuffers(TrailBuffers const &) = delete;
+        TrailBuffers& operator=(TrailBuffers const &) = delete;
+
+        // Reallocates (and clears) both targets
+        void resize(int width, int height);
+        // Resizes both targets, keeping their images (filtered, or nearest in HDR mode)
+        void rescale(int width, int height);
+
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+
+        void set_hdr(bool hdr);
+        bool hdr() const { return m_hdr; }
+
+        // Last frame's image
+        GLuint source_texture() const { return m_textures[m_current]; }
+        // Where this frame is drawn
+        GLuint target_framebuffer() const { return m_framebuffers[1 - m_current]; }
+        GLuint target_texture() const { return m_textures[1 - m_current]; }
+
+        // Makes this frame's target next frame's source
+        void swap() { m_current = 1 - m_current; }
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include "gl_state.h"
+
+/*
+  A buffer holding one std140 uniform block, laid out by the struct T, and
+  bound to a fixed binding point. Programs attach their block to it with
+  ShaderProgram::bind_uniform_block, then one update() reaches all of them.
+*/
+template<typename T>
+class UniformBuffer
+{
+    private:
+        GLuint m_buffer;
+        GLuint m_binding;
+
+    public:
+        explicit UniformBuffer(GLuint binding) : m_buffer(0), m_binding(binding) {
+          glGenBuffers(1, &m_buffer);
+          gl_state.bind_buffer(GL_UNIFORM_BUFFER, m_buffer);
+          glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+          glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_buffer);
+        }
+        ~UniformBuffer() { glDeleteBuffers(1, &m_buffer); }
+
+        UniformBuffer(UniformBuffer const &) = delete;
+        UniformBuffer& operator=(UniformBuffer const &) = delete;
+
+        GLuint binding() const { return m_binding; }
+        GLint size() const { return GLint(sizeof(T)); }
+
+        void update(T const & data) {
+          gl_state.bind_buffer(GL_UNIFORM_BUFFER, m_buffer);
+          glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        }
+};
+
+#endif
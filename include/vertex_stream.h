@@ -0,0 +1,46 @@
+#ifndef VERTEX_STREAM_H
+#define VERTEX_STREAM_H
+
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+
+/*
+  A vertex buffer rewritten every frame. With ARB_buffer_storage it is a
+  persistently mapped ring of slots guarded by fences, and vertices are
+  written straight into GPU visible memory. Otherwise they are staged and
+  uploaded with buffer orphaning.
+*/
+class VertexStream
+{
+    private:
+        static const int num_slots = 3;
+
+        GLuint m_buffer;
+        GLsizeiptr m_vertex_size;
+        GLsizei m_vertex_count;
+        bool m_persistent;
+        int m_slot;
+        uint8_t* m_mapped;
+        GLsync m_fences[num_slots];
+        std::vector<uint8_t> m_staging;
+
+    public:
+        VertexStream(GLsizeiptr vertex_size, GLsizei vertex_count, bool allow_persistent = true);
+        ~VertexStream();
+
+        VertexStream(VertexStream const &) = delete;
+        VertexStream& operator=(VertexStream const &) = delete;
+
+        GLuint buffer() const { return m_buffer; }
+        bool persistent() const { return m_persistent; }
+
+        // Where to write this frame's vertices (write only, may be uncached)
+        void* acquire();
+        // Makes them visible to GL, returns the first vertex to draw from
+        GLint submit();
+        // After the last draw reading them
+        void fence();
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef VERTEX_TYPES_H
+#define VERTEX_TYPES_H
+
+#include <glad/glad.h>
+
+/* Per iteration colour, the layout of the palette texture */
+struct VertexColour
+{
+    GLfloat r, g, b, a;
+    VertexColour() = default;
+    VertexColour(int r, int g, int b, int a)
+        : r{r/255.f}, g{g/255.f}, b{b/255.f}, a{a/255.f} {}
+} __attribute__((__packed__));
+
+/*
+  World space position in 16 bit fixed point, relative to the frame's
+  quantization window (hidden_vertex marks hidden points)
+*/
+struct VertexPos
+{
+    GLshort x, y;
+} __attribute__((__packed__));
+
+static const GLshort hidden_vertex = -32768;
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+/*
+  A fixed set of threads for data parallel jobs. run() hands out indices
+  to the workers (and the calling thread) until all are taken, and returns
+  once every job has finished.
+*/
+class WorkerPool
+{
+    private:
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        const std::function<void(int)>* m_job;
+        int m_count;
+        std::atomic<int> m_next;
+        int m_running;
+        unsigned int m_generation;
+        bool m_stop;
+
+        void work();
+        void take_jobs();
+
+    public:
+        // threads = 0 uses the hardware concurrency (less the calling thread)
+        WorkerPool(int threads = 0);
+        ~WorkerPool();
+
+        // Threads including the caller
+        int size() const { return int(m_threads.size()) + 1; }
+
+        void run(int count, const std::function<void(int)>& job);
+};
+
+#endif
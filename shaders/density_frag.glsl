@@ -0,0 +1,26 @@
+#version 330 core
+out vec4 frag_Color;
+
+//Binned (colour * alpha, alpha) sums of the frame's points
+uniform sampler2D fb_texture;
+
+in vertex_data {
+  vec2 texture_coord;
+} vertex;
+
+//As in point_frag, stamp >= 0 means HDR accumulation
+#include "frame_params.glsl"
+
+void main() {
+  vec4 sum = texture(fb_texture, vertex.texture_coord);
+  if (sum.a <= 0.0) {
+    discard;
+  }
+  if (frame.stamp < 0.0) {
+    //Close to blending each point over the last with its own small alpha
+    float coverage = 1.0 - exp(-sum.a * frame.weight);
+    frag_Color = vec4(sum.rgb / sum.a * coverage, coverage);
+  } else {
+    frag_Color = vec4(sum.rgb * frame.weight, frame.stamp);
+  }
+}
@@ -0,0 +1,11 @@
+//Per-frame parameters shared by all programs (FrameParams in Main.cpp)
+layout(std140) uniform frame_params {
+  vec4 view;
+  vec4 quant;
+  vec2 target_size;
+  float fade;
+  float point_size;
+  float weight;
+  float stamp;
+  int iters;
+} frame;
@@ -6,6 +6,10 @@ in vertex_data {
   vec4 colour;
 } vertex;
 
+//Weight scales each point's contribution. For HDR accumulation the colour
+//is premultiplied, and the alpha channel keeps the last-write time (stamp, blended with max)
+#include "frame_params.glsl"
+
 void main() {
   vec2 pt = gl_PointCoord * 2.0 - 1.0;
   float r = dot(pt, pt);
@@ -15,5 +19,9 @@ void main() {
   //Black magic
   float delta = fwidth(r)/3;
   float alpha = 1.0 - smoothstep(1.0 - delta, 1.0 + delta, r);
-  color = vec4(vertex.colour.xyz, vertex.colour.w * alpha);
+  if (frame.stamp < 0.0) {
+    color = vec4(vertex.colour.xyz, vertex.colour.w * alpha * frame.weight);
+  } else {
+    color = vec4(vertex.colour.xyz * vertex.colour.w * alpha * frame.weight, frame.stamp);
+  }
 }
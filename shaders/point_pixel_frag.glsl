@@ -0,0 +1,17 @@
+#version 330 core
+layout(location = 0) out vec4 color;
+
+in vertex_data {
+  vec4 colour;
+} vertex;
+
+//As point_frag, minus the disc (one pixel points are fully covered)
+#include "frame_params.glsl"
+
+void main() {
+  if (frame.stamp < 0.0) {
+    color = vec4(vertex.colour.xyz, vertex.colour.w * frame.weight);
+  } else {
+    color = vec4(vertex.colour.xyz * vertex.colour.w * frame.weight, frame.stamp);
+  }
+}
@@ -1,16 +1,22 @@
 #version 330 core
-layout (location = 0) in vec2 pos;
-layout (location = 1) in vec4 colour;
+layout (location = 0) in ivec2 pos;
 
 out vertex_data {
   vec4 colour;
 } vertex;
 
-uniform int window_w;
-uniform int window_h;
+#include "frame_params.glsl"
+uniform sampler2D palette;
 
 void main() {
-  vec2 fixed_pos = vec2(pos.x / window_w, pos.y / window_h);
-  gl_Position = vec4(fixed_pos, 0, 1);
-  vertex.colour = colour;
+  //Positions are 16 bit fixed point world space, -32768 marks hidden points
+  if (pos.x == -32768) {
+    gl_Position = vec4(2, 2, 2, 1);
+  } else {
+    vec2 world = frame.quant.xy + vec2(pos) / frame.quant.zw;
+    gl_Position = vec4(world * frame.view.xy + frame.view.zw, 0, 1);
+  }
+  //Points are laid out step by step, so the iteration picks the colour
+  vertex.colour = texelFetch(palette, ivec2(gl_VertexID % frame.iters, 0), 0);
+  gl_PointSize = frame.point_size;
 }
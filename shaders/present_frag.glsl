@@ -0,0 +1,34 @@
+#version 330 core
+out vec4 frag_Color;
+
+uniform sampler2D fb_texture;
+
+in vertex_data {
+  vec2 texture_coord;
+} vertex;
+
+uniform float exposure;
+uniform int tone_map;
+//Pixels last written more than cutoff frames ago have decayed away
+uniform float now;
+uniform float cutoff;
+
+//Filmic curve (ACES fit)
+vec3 filmic(vec3 x) {
+  return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main() {
+  vec4 sample = texture(fb_texture, vertex.texture_coord);
+  vec3 hdr = (now - sample.a > cutoff) ? vec3(0) : sample.rgb * exposure;
+  vec3 ldr;
+  if (any(isinf(hdr)) || any(isnan(hdr))) {
+    //A sum that overflowed is as bright as it gets
+    ldr = vec3(1.0);
+  } else if (tone_map == 1) {
+    ldr = filmic(hdr);
+  } else {
+    ldr = clamp(log2(1.0 + hdr) / log2(1.0 + 8.0), 0.0, 1.0);
+  }
+  frag_Color = vec4(ldr, 1.0);
+}
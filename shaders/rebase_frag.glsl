@@ -0,0 +1,18 @@
+#version 330 core
+out vec4 frag_Color;
+
+uniform sampler2D fb_texture;
+
+in vertex_data {
+  vec2 texture_coord;
+} vertex;
+
+//Folds the decay since the last rebase into the colour and moves the
+//last-write times (alpha) to the new epoch
+uniform float decay;
+uniform float age;
+
+void main() {
+  vec4 sample = texture(fb_texture, vertex.texture_coord);
+  frag_Color = vec4(sample.rgb * decay, sample.a - age);
+}
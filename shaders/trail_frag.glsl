@@ -7,9 +7,9 @@ in vertex_data {
   vec2 texture_coord;
 } vertex;
 
-uniform float colour_scale;
+#include "frame_params.glsl"
 
 void main() {
   vec4 sample = texture(fb_texture, vertex.texture_coord);
-  frag_Color = max(sample - colour_scale, vec4(0));
+  frag_Color = max(sample - frame.fade, vec4(0));
 }
@@ -0,0 +1,38 @@
+#version 330 core
+layout (location = 0) in ivec2 pos;
+
+out vertex_data {
+  vec4 colour;
+} vertex;
+
+out float gl_ClipDistance[4];
+
+//Every tile's points are a range of tile_points vertices, from first_vertex
+const int max_tiles = 64; //max_wall_tiles in Main.cpp
+uniform vec4 quant[max_tiles];
+uniform vec4 view[max_tiles];
+//Tile placement in the window, clip = tile clip * tile.xy + tile.zw
+uniform vec4 tile[max_tiles];
+uniform int first_vertex;
+uniform int tile_points;
+uniform sampler2D palette;
+
+#include "frame_params.glsl"
+
+void main() {
+  int index = gl_VertexID - first_vertex;
+  int i = index / tile_points;
+  vec2 clip = vec2(2, 2);
+  if (pos.x != -32768) {
+    vec2 world = quant[i].xy + vec2(pos) / quant[i].zw;
+    clip = world * view[i].xy + view[i].zw;
+  }
+  //Keep each tile's points inside it
+  gl_ClipDistance[0] = 1.0 + clip.x;
+  gl_ClipDistance[1] = 1.0 - clip.x;
+  gl_ClipDistance[2] = 1.0 + clip.y;
+  gl_ClipDistance[3] = 1.0 - clip.y;
+  gl_Position = vec4(clip * tile[i].xy + tile[i].zw, 0, 1);
+  vertex.colour = texelFetch(palette, ivec2(index % frame.iters, 0), 0);
+  gl_PointSize = frame.point_size;
+}
@@ -1,11 +1,23 @@
 // stdlib
 #include <iostream>
+#include <cmath>
 #include <random>
 #include <sstream>
+#include <iomanip>
 #include <cassert>
 #include <fstream>
 #include <exception>
 #include <functional>
+#include <future>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Boost
+#include <boost/program_options.hpp>
 
 // OpenGL
 #include <glad/glad.h>
@@ -22,6 +34,37 @@
 // Shaders
 #include "shader_program.h"
 
+// Utils
+#include "bounds_histogram.h"
+#include "frame_store.h"
+#include "checkpoint_index.h"
+#include "session_log.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "vertex_types.h"
+#include "vertex_stream.h"
+#include "trail_buffers.h"
+#include "auto_exposure.h"
+#include "density_binner.h"
+#include "gpu_profiler.h"
+#include "resolution_scaler.h"
+#include "worker_pool.h"
+#include "uniform_buffer.h"
+#include "program_cache.h"
+#include "startup_profiler.h"
+#include "screenshot_capture.h"
+
+//Shaders, embedded at build time (see the makefile)
+#include "point_vertex.glsl.h"
+#include "point_frag.glsl.h"
+#include "point_pixel_frag.glsl.h"
+#include "wall_vertex.glsl.h"
+#include "trail_vertex.glsl.h"
+#include "trail_frag.glsl.h"
+#include "present_frag.glsl.h"
+#include "rebase_frag.glsl.h"
+#include "density_frag.glsl.h"
+
 //Global constants
 static const int num_params = 18;
 static const int iters = 800;
@@ -31,10 +74,36 @@ static const double delta_minimum = 1e-7;
 static const double t_start = -3.0;
 static const double t_end = 3.0;
 static const bool fullscreen = false;
+static const int prefetch_sweep_steps = 500;
+static const int prefetch_max_attempts = 20;
+static const bool prefetch_reject_degenerate = true;
+static const double frame_lo_quantile = 0.01;
+static const double frame_hi_quantile = 0.99;
+static const double frame_decay = 0.95;
+static const float frame_smoothing = 0.05f;
+//A dense equation packs to ~0.8 MB a frame over a pass of a few thousand frames, so the
+//default only caches the start of those (the rest is recomputed), raise it with --sweep-cache
+static const size_t sweep_cache_budget_mb = 512;
+static const size_t reverse_ring_budget_mb = 256;
+static const int checkpoint_interval = 60;
+static const char* checkpoint_dir = "checkpoints";
+static const char* session_file = "checkpoints/session.txt";
+static const char* program_cache_dir = "shader_cache";
+static const char* screenshot_dir = "screenshots";
+static const float max_decay_weight = 64.0f;
+static const float decay_visible_floor = 1.0f / 4096.0f;
+//Points per pixel to bin at, a bin uploads 8 bytes against 4 for a point
+static const double density_bins_on = 2.0;
+static const double density_bins_off = 1.5;
+static const int max_wall_tiles = 64;
+static const int min_wall_tile_steps = 16;
+static const GLuint frame_params_binding = 0;
 
 //Global variables
 static int window_w = 1600;
 static int window_h = 900;
+//Replays take the size from the session log, whatever size the window ends up
+static bool replaying = false;
 static int window_bits = 24;
 static float plot_scale = 0.25f;
 static float plot_x = 0.0f;
@@ -50,16 +119,20 @@ static std::function<void(int, int)> keyhandler;
     | ImGuiWindowFlags_NoFocusOnAppearing   \
     | ImGuiWindowFlags_NoNav)
 
-struct VertexColour {
-  GLfloat r, g, b, a;
-  VertexColour() = default;
-  VertexColour(int r, int g, int b, int a)
-    : r{r/255.f}, g{g/255.f}, b{b/255.f}, a{a/255.f} {}
-} __attribute__((__packed__));
-
-struct VertexPos {
-  GLfloat x, y;
-} __attribute__((__packed__));
+//Per-frame parameters every program reads from one uniform buffer,
+//std140 layout of the frame_params block (shaders/include/frame_params.glsl)
+struct FrameParams {
+  glm::vec4 view;
+  glm::vec4 quant;
+  GLfloat target_size[2];
+  GLfloat fade;
+  GLfloat point_size;
+  GLfloat weight;
+  GLfloat stamp;
+  GLint iters;
+  GLint padding;
+};
+static_assert(sizeof(FrameParams) == 64, "FrameParams must match the std140 frame_params block");
 
 static VertexColour GetRandColor(int i) {
   i += 1;
@@ -69,17 +142,104 @@ static VertexColour GetRandColor(int i) {
   return VertexColour(r, g, b, 16);
 }
 
-static VertexPos ToScreen(double x, double y) {
-  const float s = plot_scale * float(window_h / 2);
-  const float nx = float(window_w) * 0.5f + (float(x) - plot_x) * s;
-  const float ny = float(window_h) * 0.5f + (float(y) - plot_y) * s;
-  return VertexPos{nx, ny};
+static VertexColour GetRainbowColor(int i) {
+  //Hue follows the iteration
+  const float h = 6.0f * float(i) / float(iters);
+  const float x = 1.0f - std::fabs(std::fmod(h, 2.0f) - 1.0f);
+  float r = 0.0f, g = 0.0f, b = 0.0f;
+  if (h < 1.0f)      { r = 1.0f; g = x; }
+  else if (h < 2.0f) { r = x; g = 1.0f; }
+  else if (h < 3.0f) { g = 1.0f; b = x; }
+  else if (h < 4.0f) { g = x; b = 1.0f; }
+  else if (h < 5.0f) { r = x; b = 1.0f; }
+  else               { r = 1.0f; b = x; }
+  return VertexColour(50 + int(205 * r), 50 + int(205 * g), 50 + int(205 * b), 16);
+}
+
+static const int num_palettes = 2;
+
+static std::vector<VertexColour> MakePalette(int palette_type) {
+  std::vector<VertexColour> palette(iters);
+  for (int i = 0; i < iters; ++i) {
+    palette[i] = (palette_type == 0) ? GetRandColor(i) : GetRainbowColor(i);
+  }
+  return palette;
+}
+
+//CPU side buffers, made on a worker while the window and GL context come up
+struct StartupBuffers {
+  std::vector<glm::vec2> frame_points;
+  std::vector<VertexPos> density_points;
+  std::vector<VertexColour> palette;
+};
+
+static StartupBuffers MakeStartupBuffers(int vertex_count, int palette_type) {
+  StartupBuffers buffers;
+  buffers.frame_points.resize(vertex_count);
+  buffers.density_points.resize(vertex_count);
+  buffers.palette = MakePalette(palette_type);
+  return buffers;
+}
+
+//Clip space is world * view.xy + view.zw, for a plot shown in a w x h area
+static glm::vec4 ViewTransform(float scale, float x, float y, int w, int h) {
+  const float s = scale * float(h / 2);
+  return glm::vec4(s / w, s / h, 0.5f - x * s / w, 0.5f - y * s / h);
+}
+
+static glm::vec4 ViewTransform() {
+  return ViewTransform(plot_scale, plot_x, plot_y, window_w, window_h);
+}
+
+//Points are quantized over twice the visible area, so the view can move a
+//little without re-emitting them. Gives (centre.xy, 32767 / half size.xy).
+static glm::vec4 QuantWindow(const glm::vec4& view) {
+  return glm::vec4(-view.z / view.x, -view.w / view.y, 32767.0f * view.x / 2.0f, 32767.0f * view.y / 2.0f);
+}
+
+//Points outside the quantization window (or NaN) are hidden
+static inline VertexPos PackVertex(float x, float y, const glm::vec4& quant) {
+  VertexPos v;
+#ifdef __SSE2__
+  const __m128 centre = _mm_setr_ps(quant.x, quant.y, 0.0f, 0.0f);
+  const __m128 scale = _mm_setr_ps(quant.z, quant.w, 0.0f, 0.0f);
+  const __m128 q = _mm_mul_ps(_mm_sub_ps(_mm_setr_ps(x, y, 0.0f, 0.0f), centre), scale);
+  const __m128 abs_q = _mm_andnot_ps(_mm_set1_ps(-0.0f), q);
+  if ((_mm_movemask_ps(_mm_cmple_ps(abs_q, _mm_set1_ps(32767.0f))) & 3) != 3) {
+    return VertexPos{hidden_vertex, hidden_vertex};
+  }
+  const int packed = _mm_cvtsi128_si32(_mm_packs_epi32(_mm_cvtps_epi32(q), _mm_setzero_si128()));
+  std::memcpy(&v, &packed, sizeof(v));
+#else
+  const float qx = (x - quant.x) * quant.z;
+  const float qy = (y - quant.y) * quant.w;
+  if (!(std::fabs(qx) <= 32767.0f && std::fabs(qy) <= 32767.0f)) {
+    return VertexPos{hidden_vertex, hidden_vertex};
+  }
+  v.x = GLshort(std::lrint(qx));
+  v.y = GLshort(std::lrint(qy));
+#endif
+  return v;
 }
 
-static void RandParams(double* params) {
+//Emit world space points (NaN for hidden) for drawing
+static void EmitPoints(const std::vector<glm::vec2>& points, bool iteration_limit, const glm::vec4& quant,
+                       VertexPos* vertex_pos, BoundsHistogram& bounds) {
+  for (size_t i = 0; i < points.size(); ++i) {
+    const glm::vec2& pt = points[i];
+    if (std::isnan(pt.x) || (iteration_limit && int(i % iters) < 100)) {
+      vertex_pos[i] = VertexPos{hidden_vertex, hidden_vertex};
+    } else {
+      vertex_pos[i] = PackVertex(pt.x, pt.y, quant);
+      bounds.add(pt.x, pt.y);
+    }
+  }
+}
+
+static void RandParams(double* params, std::mt19937& gen = rand_gen) {
   std::uniform_int_distribution<int> rand_int(0, 3);
   for (int i = 0; i < num_params; ++i) {
-    const int r = rand_int(rand_gen);
+    const int r = rand_int(gen);
     if (r == 0) {
       params[i] = 1.0f;
     } else if (r == 1) {
@@ -90,6 +250,80 @@ static void RandParams(double* params) {
   }
 }
 
+static inline void IterateChaos(const double* params, double t, double& x, double& y) {
+  const double xx = x * x;
+  const double yy = y * y;
+  const double tt = t * t;
+  const double xy = x * y;
+  const double xt = x * t;
+  const double yt = y * t;
+  const double nx = xx*params[0] + yy*params[1] + tt*params[2] + xy*params[3] + xt*params[4] + yt*params[5] + x*params[6] + y*params[7] + t*params[8];
+  const double ny = xx*params[9] + yy*params[10] + tt*params[11] + xy*params[12] + xt*params[13] + yt*params[14] + x*params[15] + y*params[16] + t*params[17];
+  x = nx;
+  y = ny;
+}
+
+//One frame of steps through t, writing the points out for drawing (and to the encoder if given).
+//Fewer steps than a frame's take bigger ones, so t still covers a frame's worth.
+static void StepChaos(const double* params, double speed_mult, bool iteration_limit,
+                      const glm::vec4& view, const glm::vec4& quant,
+                      double& t, double& rolling_delta, std::vector<glm::vec2>& history,
+                      BoundsHistogram& bounds, VertexPos* vertex_pos, FrameEncoder* encoder,
+                      int steps = steps_per_frame) {
+  const double step_scale = double(steps_per_frame) / steps;
+  const double delta = delta_per_step * speed_mult * step_scale;
+  const double min_delta = delta_minimum * speed_mult * step_scale;
+  rolling_delta = rolling_delta*0.99 + delta*0.01;
+
+  for (int step = 0; step < steps; ++step) {
+    bool isOffScreen = true;
+    double x = t;
+    double y = t;
+
+    for (int iter = 0; iter < iters; ++iter) {
+      IterateChaos(params, t, x, y);
+      const bool shown = !(iteration_limit && iter < 100);
+      if (shown) {
+        bounds.add(float(x), float(y));
+        vertex_pos[step*iters + iter] = PackVertex(float(x), float(y), quant);
+      } else {
+        vertex_pos[step*iters + iter] = VertexPos{hidden_vertex, hidden_vertex};
+      }
+      if (encoder) {
+        encoder->push(x, y);
+      }
+
+      //Check if dynamic delta should be adjusted
+      const float screen_x = float(x) * view.x + view.z;
+      const float screen_y = float(y) * view.y + view.w;
+      if (shown && screen_x > 0.0f && screen_y > 0.0f && screen_x < 1.0f && screen_y < 1.0f) {
+        const float dx = history[iter].x - float(x);
+        const float dy = history[iter].y - float(y);
+        const double dist = double(500.0f * std::sqrt(dx*dx + dy*dy));
+        rolling_delta = std::min(rolling_delta, std::max(delta / (dist + 1e-5), min_delta));
+        isOffScreen = false;
+      }
+      history[iter].x = float(x);
+      history[iter].y = float(y);
+    }
+
+    //Update the t variable
+    if (isOffScreen) {
+      t += 0.01 * step_scale;
+    } else {
+      t += rolling_delta;
+    }
+  }
+}
+
+//How much of the pass the repeat mode cache holds (the rest is recomputed when replaying)
+static void ReportSweepCache(const SweepCache& cache) {
+  const double cached_t = cache.empty() ? t_start : cache.frame(cache.size() - 1).t;
+  const double coverage = cache.complete() ? 1.0 : std::min(1.0, (cached_t - t_start) / (t_end - t_start));
+  std::cout << "Sweep cache: " << cache.size() << " frames, " << (cache.bytes() >> 20) << " MB, "
+            << int(coverage * 100.0) << "% of the pass" << std::endl;
+}
+
 static std::string ParamsToString(const double* params) {
   const char base27[] = "_ABCDEFGHIJKLMNOPQRSTUVWXYZ";
   static_assert(num_params % 3 == 0, "Params must be a multiple of 3");
@@ -174,29 +408,69 @@ static std::function<void()> GenerateNew(GLFWwindow* window, double& t, double*
   };
 }
 
-static void MakeTText(double t) {
+static bool MakeTText(double t, double seek_max, double& seek_t) {
+  static float seek_value = float(t_start);
+  static bool seeking = false;
   bool open = true;
+  bool seek = false;
   ImGui::Begin("Time", &open, IMGUI_BOX);
   ImGui::Text("t = %f", t);
+  //Seek bar over the checkpointed part of the sweep
+  if (seek_max >= t_start) {
+    if (!seeking) {
+      seek_value = float(std::min(t, seek_max));
+    }
+    ImGui::SliderFloat("##seek", &seek_value, float(t_start), float(seek_max), "seek %.3f");
+    seeking = ImGui::IsItemActive();
+    if (ImGui::IsItemDeactivatedAfterEdit()) {
+      seek_t = seek_value;
+      seek = true;
+    }
+  }
   ImGui::SetWindowPos(ImVec2(window_w - ImGui::GetWindowWidth() - 10.0f, 10.0f));
   ImGui::End();
+  return seek;
 }
 
-static GLFWwindow* CreateRenderWindow() {
+static void MakeProfilerPanel(const GpuProfiler& profiler, float res_scale, const GLStateCache::Counters& gl_calls,
+                              size_t binned_bytes, size_t vertex_bytes) {
+  bool open = true;
+  ImGui::Begin("GPU", &open, IMGUI_BOX);
+  ImGui::Text("Trail resolution x%.3f", res_scale);
+  if (binned_bytes > 0) {
+    ImGui::Text("Point upload: %zu KB binned (%zu KB as vertices)", binned_bytes >> 10, vertex_bytes >> 10);
+  } else {
+    ImGui::Text("Point upload: %zu KB as vertices", vertex_bytes >> 10);
+  }
+  ImGui::Text("GL state per frame: %llu calls, %llu skipped, %llu queries avoided",
+              (unsigned long long)gl_calls.issued, (unsigned long long)gl_calls.skipped,
+              (unsigned long long)gl_calls.queries);
+  ImGui::Text("%-8s %8s %8s %8s %8s", "pass", "avg ms", "p50", "p95", "p99");
+  for (const GpuPassStats& pass : profiler.stats()) {
+    ImGui::Text("%-8s %8.3f %8.3f %8.3f %8.3f", pass.name.c_str(), pass.average, pass.p50, pass.p95, pass.p99);
+  }
+  ImGui::SetWindowPos(ImVec2(10.0f, window_h - ImGui::GetWindowHeight() - 10.0f));
+  ImGui::End();
+}
+
+static GLFWwindow* CreateRenderWindow(bool visible = true) {
   //Setup OpenGL
   glfwInit();
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
   //Create the window
   GLFWwindow* window = glfwCreateWindow(window_w, window_h, "Chaos Equations", NULL, NULL);
   glfwSetFramebufferSizeCallback(window, [](GLFWwindow* window, int width, int height) {
+    if (replaying) {
+      return;
+    }
     window_w = width;
     window_h = height;
-    glViewport(0, 0, window_w, window_h);
-    //Bound texture should be the framebuffer
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, window_w, window_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    gl_state.viewport(0, 0, window_w, window_h);
+    //The trail buffers follow in the main loop
   });
   if (!window) {
     glfwTerminate();
@@ -207,10 +481,27 @@ static GLFWwindow* CreateRenderWindow() {
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
     throw std::runtime_error("Failed to init GLAD");
   }
+  LoadGLExtensions((GLADloadproc)glfwGetProcAddress);
+  gl_state.sync();
+  //Let the driver compile shaders on as many threads as it likes
+  if (gl_ext.parallel_shader_compile) {
+    gl_ext.MaxShaderCompilerThreads(0xFFFFFFFF);
+  }
 
   return window;
 }
 
+static void FramePlot(float min_x, float max_x, float min_y, float max_y,
+                      float& scale, float& x, float& y) {
+  max_x = std::fmin(max_x, 4.0f);
+  max_y = std::fmin(max_y, 4.0f);
+  min_x = std::fmax(min_x, -4.0f);
+  min_y = std::fmax(min_y, -4.0f);
+  x = (max_x + min_x) * 0.5f;
+  y = (max_y + min_y) * 0.5f;
+  scale = 1.0f / std::max(std::max(max_x - min_x, max_y - min_y) * 0.6f, 0.1f);
+}
+
 static void CenterPlot(const std::vector<glm::vec2>& history) {
   float min_x = FLT_MAX;
   float max_x = -FLT_MAX;
@@ -222,21 +513,169 @@ static void CenterPlot(const std::vector<glm::vec2>& history) {
     min_y = std::fmin(min_y, history[i].y);
     max_y = std::fmax(max_y, history[i].y);
   }
-  max_x = std::fmin(max_x, 4.0f);
-  max_y = std::fmin(max_y, 4.0f);
-  min_x = std::fmax(min_x, -4.0f);
-  min_y = std::fmax(min_y, -4.0f);
-  plot_x = (max_x + min_x) * 0.5f;
-  plot_y = (max_y + min_y) * 0.5f;
-  plot_scale = 1.0f / std::max(std::max(max_x - min_x, max_y - min_y) * 0.6f, 0.1f);
+  FramePlot(min_x, max_x, min_y, max_y, plot_scale, plot_x, plot_y);
 }
 
-static void ImguiSetup(GLFWwindow* window) {
+static void CenterPlot(const BoundsHistogram& bounds, const std::vector<glm::vec2>& history) {
+  float min_x, max_x, min_y, max_y;
+  if (bounds.bounds(frame_lo_quantile, frame_hi_quantile, min_x, max_x, min_y, max_y)) {
+    FramePlot(min_x, max_x, min_y, max_y, plot_scale, plot_x, plot_y);
+  } else {
+    CenterPlot(history);
+  }
+}
+
+//Ease the view towards the robust bounds of the recent points
+static void SmoothFramePlot(const BoundsHistogram& bounds, float& view_scale, float& view_x, float& view_y) {
+  float min_x, max_x, min_y, max_y;
+  if (!bounds.bounds(frame_lo_quantile, frame_hi_quantile, min_x, max_x, min_y, max_y)) {
+    return;
+  }
+  float scale, x, y;
+  FramePlot(min_x, max_x, min_y, max_y, scale, x, y);
+  view_x += (x - view_x) * frame_smoothing;
+  view_y += (y - view_y) * frame_smoothing;
+  view_scale *= std::pow(scale / view_scale, frame_smoothing);
+}
+
+static void SmoothFramePlot(const BoundsHistogram& bounds) {
+  SmoothFramePlot(bounds, plot_scale, plot_x, plot_y);
+}
+
+//Points per pixel over the on screen part of the recent points' bounds
+static double PointDensity(const BoundsHistogram& bounds, int num_points, float pixel_scale) {
+  float min_x, max_x, min_y, max_y;
+  if (!bounds.bounds(frame_lo_quantile, frame_hi_quantile, min_x, max_x, min_y, max_y)) {
+    return 0.0;
+  }
+  const glm::vec4 view = ViewTransform();
+  auto ToPixels = [](float world, float scale, float offset, int size) {
+    return std::min(float(size), std::max(0.0f, ((world * scale + offset) * 0.5f + 0.5f) * size));
+  };
+  const float w = ToPixels(max_x, view.x, view.z, window_w) - ToPixels(min_x, view.x, view.z, window_w);
+  const float h = ToPixels(max_y, view.y, view.w, window_h) - ToPixels(min_y, view.y, view.w, window_h);
+  return double(num_points) / std::max(1.0, double(w) * double(h) * pixel_scale * pixel_scale);
+}
+
+//An equation picked and framed ahead of time by a coarse sweep
+struct PreparedEquation {
+  double params[num_params];
+  float plot_scale;
+  float plot_x;
+  float plot_y;
+  double t;
+};
+
+static PreparedEquation PrepareEquation(unsigned int seed) {
+  std::mt19937 gen(seed);
+  PreparedEquation equ;
+  for (int attempt = 0; attempt < prefetch_max_attempts; ++attempt) {
+    RandParams(equ.params, gen);
+
+    //Coarse sweep over the whole t range, keeping only points that could be framed
+    static const int grid = 32;
+    std::vector<glm::vec2> points;
+    points.reserve(prefetch_sweep_steps * iters / 4);
+    BoundsHistogram histogram;
+    int first_step = -1;
+    for (int step = 0; step < prefetch_sweep_steps; ++step) {
+      const double t = t_start + (t_end - t_start) * step / (prefetch_sweep_steps - 1);
+      double x = t;
+      double y = t;
+      for (int iter = 0; iter < iters; ++iter) {
+        IterateChaos(equ.params, t, x, y);
+        if (std::fabs(x) <= 4.0 && std::fabs(y) <= 4.0) {
+          points.emplace_back(float(x), float(y));
+          histogram.add(float(x), float(y));
+          if (first_step < 0) first_step = step;
+        }
+      }
+    }
+    histogram.commit();
+
+    float min_x, max_x, min_y, max_y;
+    if (!histogram.bounds(frame_lo_quantile, frame_hi_quantile, min_x, max_x, min_y, max_y)) {
+      equ.plot_scale = 0.25f;
+      equ.plot_x = 0.0f;
+      equ.plot_y = 0.0f;
+      equ.t = t_start;
+      continue;
+    }
+    FramePlot(min_x, max_x, min_y, max_y, equ.plot_scale, equ.plot_x, equ.plot_y);
+
+    //Start just before the first framed point instead of sweeping through empty space
+    const double t_spacing = (t_end - t_start) / (prefetch_sweep_steps - 1);
+    equ.t = std::max(t_start, t_start + (first_step - 1) * t_spacing);
+
+    //Reject equations that collapse to a handful of points or barely show up
+    if (!prefetch_reject_degenerate) break;
+    std::vector<bool> occupied(grid * grid, false);
+    const float w = std::max(max_x - min_x, 1e-6f);
+    const float h = std::max(max_y - min_y, 1e-6f);
+    int cells = 0;
+    for (const glm::vec2& pt : points) {
+      const int cx = int((pt.x - min_x) / w * grid);
+      const int cy = int((pt.y - min_y) / h * grid);
+      if (cx < 0 || cy < 0 || cx >= grid || cy >= grid) continue;
+      if (!occupied[cy * grid + cx]) {
+        occupied[cy * grid + cx] = true;
+        cells += 1;
+      }
+    }
+    const size_t total = size_t(prefetch_sweep_steps) * iters;
+    if (cells >= grid && points.size() * 100 >= total) break;
+  }
+  return equ;
+}
+
+static std::future<PreparedEquation> PrefetchEquation() {
+  return std::async(std::launch::async, PrepareEquation, (unsigned int)rand_gen());
+}
+
+static void ApplyPrepared(const PreparedEquation& equ, double* params, double& t) {
+  std::copy(equ.params, equ.params + num_params, params);
+  plot_scale = equ.plot_scale;
+  plot_x = equ.plot_x;
+  plot_y = equ.plot_y;
+  t = equ.t;
+}
+
+//Drag to pan, scroll to zoom about the cursor
+static bool PanZoomPlot() {
+  const ImGuiIO& io = ImGui::GetIO();
+  if (io.WantCaptureMouse) {
+    return false;
+  }
+  const glm::vec4 view = ViewTransform();
+  bool moved = false;
+  if (ImGui::IsMouseDragging(0)) {
+    plot_x -= 2.0f * io.MouseDelta.x / window_w / view.x;
+    plot_y += 2.0f * io.MouseDelta.y / window_h / view.y;
+    moved = true;
+  }
+  if (io.MouseWheel != 0.0f) {
+    const float cx = (2.0f * io.MousePos.x / window_w - 1.0f - view.z) / view.x;
+    const float cy = (1.0f - 2.0f * io.MousePos.y / window_h - view.w) / view.y;
+    const float f = std::pow(1.1f, io.MouseWheel);
+    plot_scale *= f;
+    plot_x = cx - (cx - plot_x) / f;
+    plot_y = cy - (cy - plot_y) / f;
+    moved = true;
+  }
+  return moved;
+}
+
+//The context needs no window, so the font atlas can be built before there is one
+static ImFontAtlas* ImguiCreateContext() {
   IMGUI_CHECKVERSION();
   ImGui::CreateContext();
   ImGuiIO& io = ImGui::GetIO(); (void)io;
   io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
   ImGui::StyleColorsDark();
+  return io.Fonts;
+}
+
+static void ImguiSetup(GLFWwindow* window) {
   ImGui_ImplGlfw_InitForOpenGL(window, true);
   ImGui_ImplOpenGL3_Init("#version 330 core");
 }
@@ -248,7 +687,270 @@ static void NewFrame() {
   ImGui::NewFrame();
 }
 
+//One equation of the wall, running on its own
+struct WallTile {
+  double params[num_params];
+  double t;
+  double rolling_delta;
+  std::vector<glm::vec2> history;
+  BoundsHistogram bounds;
+  float plot_scale;
+  float plot_x;
+  float plot_y;
+  std::string code;
+  std::future<PreparedEquation> next;
+};
+
+static void StartTile(WallTile& tile, const PreparedEquation& equ) {
+  std::copy(equ.params, equ.params + num_params, tile.params);
+  tile.t = equ.t;
+  tile.rolling_delta = delta_per_step;
+  tile.history.assign(iters, glm::vec2());
+  tile.bounds.clear();
+  tile.plot_scale = equ.plot_scale;
+  tile.plot_x = equ.plot_x;
+  tile.plot_y = equ.plot_y;
+  tile.code = ParamsToString(tile.params);
+  tile.next = PrefetchEquation();
+}
+
+//Shows a cols x rows grid of equations in the window. Every frame the tiles are stepped
+//on a shared worker pool into one vertex buffer (a range of it each), and then drawn
+//with a single call that places and clips each range to its tile. The tiles share one
+//frame's worth of steps between them (down to a floor), so the wall costs about as
+//much as a single equation. Each tile still moves through t at the usual rate, in
+//bigger steps.
+static void RunWall(GLFWwindow* window, int cols, int rows, TrailBuffers& trail_buffers,
+                    GLuint trails, bool allow_persistent) {
+  const int num_tiles = cols * rows;
+  const int tile_steps = std::max(min_wall_tile_steps, steps_per_frame / num_tiles);
+  const int tile_points = iters * tile_steps;
+
+  ShaderProgram wall_pixel_shader(wall_vertex_glsl, point_pixel_frag_glsl);
+  ShaderProgram wall_disc_shader(wall_vertex_glsl, point_frag_glsl);
+  ShaderProgram trail_shader(trail_vertex_glsl, trail_frag_glsl);
+  UniformBuffer<FrameParams> frame_params(frame_params_binding);
+  for (ShaderProgram* program : {&wall_pixel_shader, &wall_disc_shader, &trail_shader}) {
+    program->bind_uniform_block("frame_params", frame_params.binding(), frame_params.size());
+  }
+
+  //Resolve the per-tile uniforms once, the palette unit never changes
+  struct WallUniforms {
+    Uniform<glm::vec4> view, quant, tile;
+    Uniform<GLint> tile_points, first_vertex;
+  };
+  WallUniforms wall_uniforms[2];
+  ShaderProgram* wall_shaders[2] = { &wall_pixel_shader, &wall_disc_shader };
+  for (int i = 0; i < 2; ++i) {
+    ShaderProgram& program = *wall_shaders[i];
+    wall_uniforms[i] = { program.uniform<glm::vec4>("view"), program.uniform<glm::vec4>("quant"),
+                         program.uniform<glm::vec4>("tile"), program.uniform<GLint>("tile_points"),
+                         program.uniform<GLint>("first_vertex") };
+    program.use();
+    program.uniform<GLint>("palette").set(1);
+  }
+
+  GLuint vertices;
+  glGenVertexArrays(1, &vertices);
+  gl_state.bind_vertex_array(vertices);
+  VertexStream vertex_stream(sizeof(VertexPos), tile_points * num_tiles, allow_persistent);
+  glEnableVertexAttribArray(0);
+  gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_stream.buffer());
+  glVertexAttribIPointer(0, 2, GL_SHORT, 0, nullptr);
+
+  //Pick the first equations in parallel too
+  WorkerPool pool;
+  std::vector<WallTile> tiles(num_tiles);
+  std::vector<unsigned int> seeds(num_tiles);
+  for (unsigned int& seed : seeds) {
+    seed = (unsigned int)rand_gen();
+  }
+  std::vector<PreparedEquation> first(num_tiles);
+  pool.run(num_tiles, [&](int i) { first[i] = PrepareEquation(seeds[i]); });
+  for (int i = 0; i < num_tiles; ++i) {
+    StartTile(tiles[i], first[i]);
+  }
+
+  int trail_type = 0;
+  int dot_type = 0;
+  bool iteration_limit = false;
+  bool restart_all = false;
+  keyhandler = [&](int key, int action) {
+    if (action != GLFW_PRESS) {
+      return;
+    }
+    if (key == GLFW_KEY_ESCAPE) {
+      glfwSetWindowShouldClose(window, GLFW_TRUE);
+    } else if (key == GLFW_KEY_D) {
+      dot_type = (dot_type + 1) % 3;
+    } else if (key == GLFW_KEY_I) {
+      iteration_limit = !iteration_limit;
+    } else if (key == GLFW_KEY_N) {
+      restart_all = true;
+    } else if (key == GLFW_KEY_T) {
+      trail_type = (trail_type + 1) % 4;
+    }
+  };
+  glfwSetKeyCallback(window,
+    [](GLFWwindow* window, int key, int scancode, int action, int mods) {
+      keyhandler(key, action);
+    });
+
+  std::vector<glm::vec4> views(num_tiles);
+  std::vector<glm::vec4> quants(num_tiles);
+  std::vector<glm::vec4> placements(num_tiles);
+  while (!glfwWindowShouldClose(window)) {
+    glfwPollEvents();
+
+    //Step every tile
+    const int tile_w = std::max(1, window_w / cols);
+    const int tile_h = std::max(1, window_h / rows);
+    VertexPos* vertex_pos = static_cast<VertexPos*>(vertex_stream.acquire());
+    pool.run(num_tiles, [&](int i) {
+      WallTile& tile = tiles[i];
+      views[i] = ViewTransform(tile.plot_scale, tile.plot_x, tile.plot_y, tile_w, tile_h);
+      quants[i] = QuantWindow(views[i]);
+      StepChaos(tile.params, 1.0, iteration_limit, views[i], quants[i], tile.t, tile.rolling_delta,
+                tile.history, tile.bounds, vertex_pos + size_t(i) * tile_points, nullptr, tile_steps);
+      tile.bounds.commit(frame_decay);
+      SmoothFramePlot(tile.bounds, tile.plot_scale, tile.plot_x, tile.plot_y);
+    });
+    for (WallTile& tile : tiles) {
+      if (restart_all || tile.t > t_end) {
+        StartTile(tile, tile.next.get());
+      }
+    }
+    restart_all = false;
+
+    NewFrame();
+
+    //Fade the trails of every tile at once
+    if (trail_buffers.width() != window_w || trail_buffers.height() != window_h) {
+      trail_buffers.resize(window_w, window_h);
+    }
+    static const float fade_speeds[] = { 10/255.f,2/255.f, 0.0f , 1.0f };
+    static const float dot_sizes[] = { 1.0f, 3.0f, 10.0f };
+    FrameParams frame = {};
+    frame.target_size[0] = float(trail_buffers.width());
+    frame.target_size[1] = float(trail_buffers.height());
+    frame.fade = fade_speeds[trail_type];
+    frame.point_size = dot_sizes[dot_type];
+    frame.weight = 1.0f;
+    frame.stamp = -1.0f;
+    frame.iters = iters;
+    frame_params.update(frame);
+
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, trail_buffers.target_framebuffer());
+    gl_state.viewport(0, 0, trail_buffers.width(), trail_buffers.height());
+    gl_state.bind_texture(GL_TEXTURE_2D, trail_buffers.source_texture());
+    trail_shader.use();
+    gl_state.bind_vertex_array(trails);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+    //Draw every tile's points in one go
+    for (int i = 0; i < num_tiles; ++i) {
+      const int c = i % cols;
+      const int r = i / cols;
+      placements[i] = glm::vec4(1.0f / cols, 1.0f / rows, -1.0f + (2.0f*c + 1.0f) / cols, 1.0f - (2.0f*r + 1.0f) / rows);
+    }
+    ShaderProgram& point_shader = *wall_shaders[dot_type == 0 ? 0 : 1];
+    const WallUniforms& uniforms = wall_uniforms[dot_type == 0 ? 0 : 1];
+    gl_state.enable(GL_BLEND);
+    gl_state.enable(GL_PROGRAM_POINT_SIZE);
+    gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    for (int plane = 0; plane < 4; ++plane) {
+      gl_state.enable(GL_CLIP_DISTANCE0 + plane);
+    }
+    point_shader.use();
+    uniforms.view.set(views.data(), num_tiles);
+    uniforms.quant.set(quants.data(), num_tiles);
+    uniforms.tile.set(placements.data(), num_tiles);
+    uniforms.tile_points.set(tile_points);
+    const GLint first_vertex = vertex_stream.submit();
+    uniforms.first_vertex.set(first_vertex);
+    gl_state.bind_vertex_array(vertices);
+    glDrawArrays(GL_POINTS, first_vertex, tile_points * num_tiles);
+    vertex_stream.fence();
+    for (int plane = 0; plane < 4; ++plane) {
+      gl_state.disable(GL_CLIP_DISTANCE0 + plane);
+    }
+    gl_state.disable(GL_BLEND);
+
+    //Draw to screen
+    gl_state.bind_framebuffer(GL_READ_FRAMEBUFFER, trail_buffers.target_framebuffer());
+    gl_state.bind_framebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, trail_buffers.width(), trail_buffers.height(),
+                      0, 0, window_w, window_h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+    gl_state.viewport(0, 0, window_w, window_h);
+    trail_buffers.swap();
+
+    //Label each tile with its code
+    ImDrawList* labels = ImGui::GetForegroundDrawList();
+    for (int i = 0; i < num_tiles; ++i) {
+      const ImVec2 corner(float((i % cols) * tile_w) + 6.0f, float((i / cols) * tile_h) + 4.0f);
+      labels->AddText(corner, IM_COL32(255, 255, 255, 160), tiles[i].code.c_str());
+    }
+
+    ImGui::Render();
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    glfwSwapBuffers(window);
+  }
+
+  //Don't leave the prefetches running past the end
+  for (WallTile& tile : tiles) {
+    if (tile.next.valid()) {
+      tile.next.wait();
+    }
+  }
+}
+
 int main(int argc, char *argv[]) {
+  StartupProfiler startup;
+  namespace po = boost::program_options;
+  po::options_description options("Options");
+  options.add_options()
+    ("help", "Show this help")
+    ("code", po::value<std::string>(), "Start with the equation with this 6 letter code")
+    ("seek", po::value<double>(), "Resume the equation at this t (from its checkpoints)")
+    ("resume", "Resume the equation and t of the last session")
+    ("seed", po::value<unsigned int>(), "Random seed (defaults to the time)")
+    ("record", po::value<std::string>(), "Record the session to this file")
+    ("replay", po::value<std::string>(), "Replay a recorded session at full speed")
+    ("headless", "Don't show the window (for replays)")
+    ("no-persistent-map", "Upload points with glBufferSubData even if ARB_buffer_storage is available")
+    ("no-density-bins", "Always draw points, never bin dense one pixel points on the CPU")
+    ("sweep-cache", po::value<size_t>(), "Memory for replaying the first pass in repeat mode (MB, default 512)")
+    ("no-program-cache", "Always compile the shaders, don't load or store program binaries")
+    ("shader-dir", po::value<std::string>(), "Read shaders from this directory when it has them, instead of the built in ones")
+    ("startup-profile", "Print how long each startup phase took, up to the first frame")
+    ("gpu-profile", po::value<std::string>(), "Log GPU time per render pass to this CSV file")
+    ("frame-budget", po::value<double>(), "Scale the trail resolution to hold this GPU time per frame (ms)")
+    ("wall", po::value<std::string>(), "Show a grid of equations instead, as COLSxROWS (up to 64 tiles)");
+  po::variables_map args;
+  try {
+    po::store(po::parse_command_line(argc, argv, options), args);
+    po::notify(args);
+  } catch (const po::error& e) {
+    std::cerr << e.what() << std::endl << options << std::endl;
+    return 1;
+  }
+  if (args.count("help")) {
+    std::cout << options << std::endl;
+    return 0;
+  }
+  int wall_cols = 0;
+  int wall_rows = 0;
+  if (args.count("wall")) {
+    const std::string wall = args["wall"].as<std::string>();
+    if (std::sscanf(wall.c_str(), "%dx%d", &wall_cols, &wall_rows) != 2 ||
+        wall_cols < 1 || wall_rows < 1 || wall_cols * wall_rows > max_wall_tiles) {
+      std::cerr << "Bad --wall size: " << wall << std::endl;
+      return 1;
+    }
+  }
+
+  const int banner_phase = startup.begin("banner");
   std::cout << "=========================================================" << std::endl;
   std::cout << std::endl;
   std::cout << "                      Chaos Equations" << std::endl;
@@ -266,9 +968,14 @@ int main(int argc, char *argv[]) {
   std::cout << "      'R' - Repeat Mode (keep same equation)" << std::endl;
   std::cout << std::endl;
   std::cout << "      'C' - Center points" << std::endl;
+  std::cout << "      'F' - Auto-Framing Toggle" << std::endl;
+  std::cout << "  'Mouse' - Drag to pan, scroll to zoom" << std::endl;
   std::cout << "      'D' - Dot size Toggle" << std::endl;
   std::cout << "      'I' - Iteration Limit Toggle" << std::endl;
+  std::cout << "      'K' - Palette Toggle" << std::endl;
+  std::cout << "      'G' - GPU Profiler Toggle" << std::endl;
   std::cout << "      'T' - Trail Toggle" << std::endl;
+  std::cout << "      'H' - HDR Accumulation Toggle (filmic, log)" << std::endl;
   std::cout << std::endl;
   std::cout << "      'P' - Pause" << std::endl;
   std::cout << " 'LShift' - Slow Down" << std::endl;
@@ -278,13 +985,65 @@ int main(int argc, char *argv[]) {
   std::cout << "     'N' - New Equation (random)" << std::endl;
   std::cout << "     'L' - Load Equation" << std::endl;
   std::cout << "     'S' - Save Equation" << std::endl;
+  std::cout << "     'X' - Screenshot" << std::endl;
   std::cout << std::endl;
-
-  //Set random seed
-  rand_gen.seed((unsigned int)time(0));
+  std::cout << "Run with --help for command line options (seeking, resuming)." << std::endl;
+  std::cout << std::endl;
+  startup.end(banner_phase);
+
+  //Set random seed (a replay uses the recorded one)
+  unsigned int seed = args.count("seed") ? args["seed"].as<unsigned int>() : (unsigned int)time(0);
+  //The sweep cache changes how seeks resolve, so a replay uses the recorded budget too
+  size_t sweep_cache_mb = args.count("sweep-cache") ? args["sweep-cache"].as<size_t>() : sweep_cache_budget_mb;
+  SessionPlayer session_player;
+  SessionRecorder session_recorder;
+  if (args.count("replay")) {
+    if (!session_player.open(args["replay"].as<std::string>())) {
+      return 1;
+    }
+    seed = session_player.seed();
+    window_w = session_player.width();
+    window_h = session_player.height();
+    sweep_cache_mb = session_player.sweep_cache_mb();
+    replaying = true;
+  }
+  rand_gen.seed(seed);
+
+  //CPU side setup and the font atlas run on workers while the window comes up
+  int palette_type = 0;
+  std::future<StartupBuffers> startup_buffers = std::async(std::launch::async, [&startup, palette_type]() {
+    const int phase = startup.begin("cpu buffers");
+    StartupBuffers buffers = MakeStartupBuffers(iters * steps_per_frame, palette_type);
+    startup.end(phase);
+    return buffers;
+  });
+  ImFontAtlas* font_atlas = ImguiCreateContext();
+  std::future<void> fonts_built = std::async(std::launch::async, [&startup, font_atlas]() {
+    const int phase = startup.begin("font atlas");
+    unsigned char* pixels;
+    int width, height;
+    font_atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+    startup.end(phase);
+  });
 
   //Create the window
-  GLFWwindow* window = CreateRenderWindow();
+  const int window_phase = startup.begin("window");
+  GLFWwindow* window = CreateRenderWindow(args.count("headless") == 0);
+  //Terminates GLFW on the way out, after every GL object declared below is destroyed
+  struct GlfwScope { ~GlfwScope() { glfwTerminate(); } } glfw_scope;
+  startup.end(window_phase);
+  const int gl_setup_phase = startup.begin("gl setup");
+  if (args.count("no-program-cache") == 0) {
+    program_cache.open(program_cache_dir);
+  }
+  if (args.count("shader-dir")) {
+    SetShaderOverrideDir(args["shader-dir"].as<std::string>());
+  }
+  if (session_player.is_open()) {
+    glfwSwapInterval(0);
+  } else if (args.count("record")) {
+    session_recorder.open(args["record"].as<std::string>(), seed, window_w, window_h, sweep_cache_mb);
+  }
 
   //Simulation variables
   double t = t_start;
@@ -294,76 +1053,160 @@ int main(int argc, char *argv[]) {
   double speed_mult = 1.0;
   bool paused = false;
   int trail_type = 0;
+  int tone_map = 0;
+  int decay_age = 0;
+  float decay_epoch_rate = 1.0f;
   int dot_type = 0;
   bool load_started = false;
   bool shuffle_equ = true;
   bool iteration_limit = false;
+  bool auto_frame = false;
+  BoundsHistogram point_bounds;
+
+  //Repeat mode replays the first full pass from here
+  SweepCache sweep_cache(sweep_cache_mb << 20);
+  FrameEncoder frame_encoder(iters);
+  bool cache_recording = false;
+  bool cache_replaying = false;
+  size_t cache_cursor = 0;
+  //Reversing walks back through recently shown frames
+  FrameRing frame_ring(reverse_ring_budget_mb << 20);
+  double ring_pos = 0.0;
+  double shown_t = t;
+
+  auto ResetSweepCache = [&]() {
+    sweep_cache.clear();
+    cache_recording = false;
+    cache_replaying = false;
+  };
+  auto ClearFrameRing = [&]() {
+    frame_encoder.discard();
+    frame_ring.clear();
+    ring_pos = 0.0;
+  };
+  //Frames come back from the encoder a frame or so after they were shown
+  auto CollectFrames = [&](bool wait) {
+    EncodedFrame done;
+    while (frame_encoder.collect(done, wait)) {
+      if (done.cache && cache_recording && !sweep_cache.add(PackedFrame(done.frame), done.history)) {
+        cache_recording = false;
+        ReportSweepCache(sweep_cache);
+      }
+      if (done.ring) {
+        frame_ring.push(std::move(done.frame));
+      }
+    }
+  };
+
+  //Checkpoints of the current equation, for seeking and resuming (a replay never saves them)
+  CheckpointIndex checkpoint_index(checkpoint_dir);
+  size_t live_frames = 0;
+  auto OpenCheckpoints = [&]() {
+    if (!session_player.is_open()) {
+      checkpoint_index.save();
+    }
+    checkpoint_index.open(ParamsToString(params));
+    live_frames = 0;
+  };
+  //Returns the checkpoint resumed from, if any (a replay passes the logged one)
+  auto SeekTo = [&](double target, const Checkpoint* logged) -> const Checkpoint* {
+    checkpoint_index.keep();
+    ClearFrameRing();
+    //The cached pass is exact, so prefer it when it covers the target
+    if (!sweep_cache.empty() && !cache_recording) {
+      const size_t i = sweep_cache.seek(target);
+      if (i < sweep_cache.size()) {
+        cache_cursor = i;
+        cache_replaying = true;
+        return nullptr;
+      }
+    }
+    if (cache_recording) {
+      ResetSweepCache();
+    }
+    cache_replaying = false;
+    const Checkpoint* cp = session_player.is_open() ? logged : checkpoint_index.find(target);
+    if (!cp) {
+      std::cout << "No checkpoints for " << ParamsToString(params) << std::endl;
+      return nullptr;
+    }
+    t = cp->t;
+    rolling_delta = cp->rolling_delta;
+    plot_scale = cp->plot_scale;
+    plot_x = cp->plot_x;
+    plot_y = cp->plot_y;
+    if (cp->history.size() == history.size()) {
+      history = cp->history;
+    }
+    shown_t = t;
+    return cp;
+  };
 
   //Setup the vertex array
   auto vertex_count = iters*steps_per_frame;
 
-  std::vector<VertexPos> vertex_pos(vertex_count);
-  std::vector<VertexColour> vertex_colour(vertex_count);
-  for (size_t i = 0; i < vertex_colour.size(); ++i) {
-    vertex_colour[i] = GetRandColor(i % iters);
-  }
+  StartupBuffers buffers = startup_buffers.get();
+  std::vector<glm::vec2> frame_points = std::move(buffers.frame_points);
 
   GLuint vertices;
   glGenVertexArrays(1, &vertices);
-  glBindVertexArray(vertices);
-
-  GLuint vertices_pos_buffer;
-  glGenBuffers(1, &vertices_pos_buffer);
-  glBindBuffer(GL_ARRAY_BUFFER, vertices_pos_buffer);
-  glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(VertexPos), nullptr, GL_STREAM_DRAW);
+  gl_state.bind_vertex_array(vertices);
+
+  //The kernel writes each frame's points straight into this
+  VertexStream vertex_stream(sizeof(VertexPos), vertex_count, args.count("no-persistent-map") == 0);
+  VertexPos* vertex_pos = nullptr;
+  std::cout << "Point upload: " << (vertex_stream.persistent() ? "persistent mapped ring" : "buffer orphaning") << std::endl;
+
+  //Dense one pixel points are binned on the CPU instead (see PointDensity)
+  const bool allow_density_bins = args.count("no-density-bins") == 0;
+  std::vector<VertexPos> density_points = std::move(buffers.density_points);
+  DensityBinner density_binner;
+  bool density_frame = false;
+
+  //GPU time per pass, shown with 'G'
+  GpuProfiler gpu_profiler;
+  bool show_profiler = false;
+  GLStateCache::Counters gl_frame_calls = {};
+  const bool profile_csv = args.count("gpu-profile") != 0;
+  if (profile_csv) {
+    if (!gpu_profiler.open_csv(args["gpu-profile"].as<std::string>())) {
+      std::cout << "Could not open " << args["gpu-profile"].as<std::string>() << std::endl;
+    }
+    gpu_profiler.set_enabled(true);
+  }
 
-  GLuint vertices_colour_buffer;
-  glGenBuffers(1, &vertices_colour_buffer);
-  glBindBuffer(GL_ARRAY_BUFFER, vertices_colour_buffer);
-  glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(VertexColour), nullptr, GL_STREAM_DRAW);
+  //Trail resolution follows the GPU time (which needs the profiler)
+  ResolutionScaler resolution_scaler(args.count("frame-budget") ? args["frame-budget"].as<double>() : 0.0);
+  float trail_scale = resolution_scaler.scale();
+  gpu_profiler.set_enabled(gpu_profiler.enabled() || resolution_scaler.enabled());
 
   glEnableVertexAttribArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, vertices_pos_buffer);
-  glVertexAttribPointer(0, sizeof(VertexPos)/sizeof(GLfloat), GL_FLOAT, GL_FALSE, 0, nullptr);
-
-  glEnableVertexAttribArray(1);
-  glBindBuffer(GL_ARRAY_BUFFER, vertices_colour_buffer);
-  glVertexAttribPointer(1, sizeof(VertexColour)/sizeof(GLfloat), GL_FLOAT, GL_FALSE, 0, nullptr);
-
-  auto UpdateVertexBuffers = [&]() {
-    // Update pos buffer (with buffer orphaning)
-    glBindBuffer(GL_ARRAY_BUFFER, vertices_pos_buffer);
-    glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(VertexPos), nullptr, GL_STREAM_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_count * sizeof(VertexPos), reinterpret_cast<GLfloat*>(vertex_pos.data()));
-
-    // Update colour buffer in the same way
-    glBindBuffer(GL_ARRAY_BUFFER, vertices_colour_buffer);
-    glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(VertexColour), nullptr, GL_STREAM_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_count * sizeof(VertexColour), reinterpret_cast<GLfloat*>(vertex_colour.data()));
-  };
-
-  //ImGui
-  ImguiSetup(window);
-
-  //Framebuffer
-  GLuint fb;
-  glGenFramebuffers(1, &fb);
-  glBindFramebuffer(GL_FRAMEBUFFER, fb);
-
-  GLuint fb_texture;
-  glGenTextures(1, &fb_texture);
-  glBindTexture(GL_TEXTURE_2D, fb_texture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, window_w, window_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_stream.buffer());
+  glVertexAttribIPointer(0, 2, GL_SHORT, 0, nullptr);
+
+  //Colours are looked up per iteration in the vertex shader (on texture unit 1)
+  GLuint palette_texture;
+  gl_state.active_texture(GL_TEXTURE1);
+  glGenTextures(1, &palette_texture);
+  gl_state.bind_texture(GL_TEXTURE_2D, palette_texture);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  gl_state.active_texture(GL_TEXTURE0);
 
-  glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, fb_texture, 0);
+  auto UploadPalette = [&](const std::vector<VertexColour>& palette) {
+    gl_state.active_texture(GL_TEXTURE1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, iters, 1, 0, GL_RGBA, GL_FLOAT, palette.data());
+    gl_state.active_texture(GL_TEXTURE0);
+    density_binner.set_palette(palette.data(), iters);
+  };
+  UploadPalette(buffers.palette);
 
-  GLenum draw_buffers[1] = {GL_COLOR_ATTACHMENT0};
-  glDrawBuffers(1, draw_buffers);
+  //ImGui (the atlas becomes a texture in the first frame), once the atlas worker is done with the context
+  fonts_built.wait();
+  ImguiSetup(window);
 
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		return false;
+  //Trail framebuffers
+  TrailBuffers trail_buffers(window_w, window_h);
 
   static GLfloat fb_quad[] = {
     // positions   // texture coords
@@ -380,11 +1223,11 @@ int main(int argc, char *argv[]) {
 
   GLuint trails;
   glGenVertexArrays(1, &trails);
-  glBindVertexArray(trails);
+  gl_state.bind_vertex_array(trails);
 
   GLuint fb_vertices;
   glGenBuffers(1, &fb_vertices);
-  glBindBuffer(GL_ARRAY_BUFFER, fb_vertices);
+  gl_state.bind_buffer(GL_ARRAY_BUFFER, fb_vertices);
   glBufferData(GL_ARRAY_BUFFER, sizeof(fb_quad), fb_quad, GL_STATIC_DRAW);
 
   glEnableVertexAttribArray(0);
@@ -395,26 +1238,98 @@ int main(int argc, char *argv[]) {
 
   GLuint fb_tris;
   glGenBuffers(1, &fb_tris);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fb_tris);
+  gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, fb_tris);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(fb_idxs), fb_idxs, GL_STATIC_DRAW);
 
-  //Initialize shaders
+  //Or show a wall of equations instead
+  if (wall_cols > 0) {
+    RunWall(window, wall_cols, wall_rows, trail_buffers, trails, args.count("no-persistent-map") == 0);
+    return 0;
+  }
+
+  startup.end(gl_setup_phase);
+
+  //Initialize shaders (compiled in parallel when the driver can, see ShaderProgram::finish)
   {
-    ShaderProgram point_shader(
-      "./shaders/point_vertex.glsl",
-      "./shaders/point_frag.glsl", "");
-    ShaderProgram trail_shader(
-      "./shaders/trail_vertex.glsl",
-      "./shaders/trail_frag.glsl",
-      "");
-
-    //Initialize random parameters
-    ResetPlot();
-    RandParams(params);
+    const int shaders_phase = startup.begin("shaders");
+    //One pixel dots skip the anti-aliased disc
+    ShaderProgram point_pixel_shader(point_vertex_glsl, point_pixel_frag_glsl);
+    ShaderProgram point_disc_shader(point_vertex_glsl, point_frag_glsl);
+    ShaderProgram trail_shader(trail_vertex_glsl, trail_frag_glsl);
+    ShaderProgram present_shader(trail_vertex_glsl, present_frag_glsl);
+    ShaderProgram rebase_shader(trail_vertex_glsl, rebase_frag_glsl);
+    ShaderProgram density_shader(trail_vertex_glsl, density_frag_glsl);
+
+    //Shared per-frame parameters go up once, pass specific uniforms are resolved here
+    UniformBuffer<FrameParams> frame_params(frame_params_binding);
+    for (ShaderProgram* program : {&point_pixel_shader, &point_disc_shader, &trail_shader, &density_shader}) {
+      program->bind_uniform_block("frame_params", frame_params.binding(), frame_params.size());
+    }
+    for (ShaderProgram* program : {&point_pixel_shader, &point_disc_shader}) {
+      program->use();
+      program->uniform<GLint>("palette").set(1);
+    }
+    const Uniform<GLfloat> rebase_decay_uniform = rebase_shader.uniform<GLfloat>("decay");
+    const Uniform<GLfloat> rebase_age_uniform = rebase_shader.uniform<GLfloat>("age");
+    const Uniform<GLfloat> present_exposure_uniform = present_shader.uniform<GLfloat>("exposure");
+    const Uniform<GLint> present_tone_map_uniform = present_shader.uniform<GLint>("tone_map");
+    const Uniform<GLfloat> present_now_uniform = present_shader.uniform<GLfloat>("now");
+    const Uniform<GLfloat> present_cutoff_uniform = present_shader.uniform<GLfloat>("cutoff");
+    AutoExposure auto_exposure;
+    ScreenshotCapture screenshots(screenshot_dir);
+    bool take_screenshot = false;
+    startup.end(shaders_phase);
+
+    //Initialize random parameters, and start looking for the next equation
+    const int equation_phase = startup.begin("first equation");
     auto RenderEquation = GenerateNew(window, t, params);
+    ApplyPrepared(PrepareEquation((unsigned int)rand_gen()), params, t);
+    std::future<PreparedEquation> next_equ = PrefetchEquation();
+    startup.end(equation_phase);
+
+    auto LoadEquation = [&](const std::string& code) {
+      ResetPlot();
+      StringToParams(code, params);
+      GenerateNew(window, t, params);
+      point_bounds.clear();
+      ResetSweepCache();
+      ClearFrameRing();
+      OpenCheckpoints();
+      checkpoint_index.keep();
+    };
+
+    //Or pick up an equation (and t) from the command line or the last session
+    std::string start_code;
+    double start_t = t_start;
+    bool start_seek = false;
+    if (args.count("resume")) {
+      std::ifstream fin(session_file);
+      if (fin >> start_code >> start_t) {
+        start_seek = true;
+      } else {
+        std::cout << "No session to resume" << std::endl;
+      }
+    }
+    if (args.count("code")) {
+      start_code = args["code"].as<std::string>();
+    }
+    if (args.count("seek")) {
+      start_t = args["seek"].as<double>();
+      start_seek = true;
+    }
+    OpenCheckpoints();
+    if (!start_code.empty() && !session_player.is_open()) {
+      shuffle_equ = false;
+      LoadEquation(start_code);
+      if (session_recorder.is_open()) {
+        session_recorder.load(start_code);
+      }
+    }
+    bool pending_seek = start_seek && !session_player.is_open();
+    double pending_seek_t = start_t;
 
     //Keyhandler
-    keyhandler = [&](int key, int action) {
+    auto HandleKey = [&](int key, int action) {
       if (action != GLFW_PRESS) return;
       if (key == GLFW_KEY_ESCAPE) {
         glfwSetWindowShouldClose(window, true);
@@ -422,20 +1337,39 @@ int main(int argc, char *argv[]) {
       } else if (key == GLFW_KEY_A) {
         shuffle_equ = true;
       } else if (key == GLFW_KEY_C) {
-        CenterPlot(history);
+        CenterPlot(point_bounds, history);
       } else if (key == GLFW_KEY_D) {
         dot_type = (dot_type + 1) % 3;
+      } else if (key == GLFW_KEY_F) {
+        auto_frame = !auto_frame;
+      } else if (key == GLFW_KEY_H) {
+        tone_map = (tone_map + 1) % 3;
+        const bool was_hdr = trail_buffers.hdr();
+        trail_buffers.set_hdr(tone_map != 0);
+        if (trail_buffers.hdr() != was_hdr) {
+          decay_age = 0;
+        }
       } else if (key == GLFW_KEY_I) {
         iteration_limit = !iteration_limit;
+      } else if (key == GLFW_KEY_G) {
+        show_profiler = !show_profiler;
+        gpu_profiler.set_enabled(show_profiler || profile_csv || resolution_scaler.enabled());
+      } else if (key == GLFW_KEY_K) {
+        palette_type = (palette_type + 1) % num_palettes;
+        UploadPalette(MakePalette(palette_type));
       } else if (key == GLFW_KEY_L) {
         shuffle_equ = false;
         load_started = true;
         paused = false;
         return;
       } else if (key == GLFW_KEY_N) {
-        ResetPlot();
-        RandParams(params);
         RenderEquation = GenerateNew(window, t, params);
+        ApplyPrepared(next_equ.get(), params, t);
+        next_equ = PrefetchEquation();
+        point_bounds.clear();
+        ResetSweepCache();
+        ClearFrameRing();
+        OpenCheckpoints();
       } else if (key == GLFW_KEY_P) {
         paused = !paused;
       } else if (key == GLFW_KEY_R) {
@@ -444,11 +1378,77 @@ int main(int argc, char *argv[]) {
         std::ofstream fout("saved.txt", std::ios::app);
         fout << equ_code << std::endl;
         std::cout << "Saved: " << equ_code << std::endl;
+        checkpoint_index.keep();
       } else if (key == GLFW_KEY_T) {
         trail_type = (trail_type + 1) % 4;
+      } else if (key == GLFW_KEY_X) {
+        take_screenshot = true;
+      }
+    };
+
+    //A replayed session only takes keys from its log (apart from quitting)
+    keyhandler = [&](int key, int action) {
+      if (session_player.is_open()) {
+        if (key == GLFW_KEY_ESCAPE) HandleKey(key, action);
+        return;
+      }
+      if (action == GLFW_PRESS && session_recorder.is_open()) {
+        session_recorder.key(key);
       }
+      HandleKey(key, action);
     };
 
+    //Applies the logged input for the next frame, false at the end of the log
+    size_t replayed_frames = 0;
+    const double replay_start = glfwGetTime();
+    auto ReplayInputs = [&]() {
+      SessionRecord record;
+      while (session_player.next(record)) {
+        switch (record.type) {
+        case SessionEvent::Frame:
+          speed_mult = record.value;
+          replayed_frames += 1;
+          return true;
+        case SessionEvent::Key:
+          HandleKey(record.key, GLFW_PRESS);
+          break;
+        case SessionEvent::Resize: {
+          window_w = record.width;
+          window_h = record.height;
+          //The log has framebuffer pixels, GLFW sizes windows in screen coordinates
+          int fb_w, fb_h, screen_w, screen_h;
+          glfwGetFramebufferSize(window, &fb_w, &fb_h);
+          glfwGetWindowSize(window, &screen_w, &screen_h);
+          glfwSetWindowSize(window, window_w * screen_w / std::max(fb_w, 1), window_h * screen_h / std::max(fb_h, 1));
+          break;
+        }
+        case SessionEvent::Load:
+          shuffle_equ = false;
+          LoadEquation(record.code);
+          break;
+        case SessionEvent::Equation:
+          if (record.code != ParamsToString(params)) {
+            std::cout << "Replay diverged at frame " << replayed_frames << ": expected "
+                      << record.code << ", got " << ParamsToString(params) << std::endl;
+          }
+          break;
+        case SessionEvent::Seek:
+          SeekTo(record.value, record.has_checkpoint ? &record.checkpoint : nullptr);
+          break;
+        case SessionEvent::View:
+          plot_scale = record.view[0];
+          plot_x = record.view[1];
+          plot_y = record.view[2];
+          break;
+        }
+      }
+      return false;
+    };
+    std::string logged_code;
+    int logged_w = window_w;
+    int logged_h = window_h;
+    bool view_moved = false;
+
     //Main Loop
     glfwSetKeyCallback(window,
       [](GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -458,143 +1458,417 @@ int main(int argc, char *argv[]) {
     while (!glfwWindowShouldClose(window)) {
       glfwPollEvents();
 
-      //Change simulation speed if using shift modifiers
-      if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
-        speed_mult = 0.1;
-      } else if (glfwGetKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS) {
-        speed_mult = 10.0;
+      if (session_player.is_open()) {
+        if (!ReplayInputs()) {
+          glfwSetWindowShouldClose(window, true);
+          continue;
+        }
       } else {
-        speed_mult = 1.0;
-      }
-      if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-        speed_mult = -speed_mult;
+        //Change simulation speed if using shift modifiers
+        if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
+          speed_mult = 0.1;
+        } else if (glfwGetKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS) {
+          speed_mult = 10.0;
+        } else {
+          speed_mult = 1.0;
+        }
+        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
+          speed_mult = -speed_mult;
+        }
+
+        if (session_recorder.is_open() && (window_w != logged_w || window_h != logged_h)) {
+          session_recorder.resize(window_w, window_h);
+          logged_w = window_w;
+          logged_h = window_h;
+        }
+        if (session_recorder.is_open() && view_moved) {
+          session_recorder.view(plot_scale, plot_x, plot_y);
+        }
+        view_moved = false;
+        if (pending_seek) {
+          const Checkpoint* cp = SeekTo(pending_seek_t, nullptr);
+          if (session_recorder.is_open()) {
+            session_recorder.seek(pending_seek_t, cp);
+          }
+          pending_seek = false;
+        }
+        if (session_recorder.is_open() && ParamsToString(params) != logged_code) {
+          logged_code = ParamsToString(params);
+          session_recorder.equation(logged_code);
+        }
       }
 
       //Skip all drawing if paused
       if (paused) {
         continue;
       }
+      if (session_recorder.is_open()) {
+        session_recorder.frame(speed_mult);
+      }
 
       //Automatic restart
       if (t > t_end) {
-        if (shuffle_equ) {
-          ResetPlot();
-          RandParams(params);
+        CollectFrames(true);
+        if (cache_recording) {
+          sweep_cache.finish();
+          cache_recording = false;
+          ReportSweepCache(sweep_cache);
         }
         RenderEquation = GenerateNew(window, t, params);
+        ClearFrameRing();
+        if (shuffle_equ) {
+          ApplyPrepared(next_equ.get(), params, t);
+          next_equ = PrefetchEquation();
+          point_bounds.clear();
+          ResetSweepCache();
+          OpenCheckpoints();
+        } else if (sweep_cache.empty()) {
+          cache_recording = true;
+        } else {
+          cache_replaying = true;
+          cache_cursor = 0;
+        }
       }
 
-      //Smooth out the stepping speed.
-      const int steps = steps_per_frame;
-      const double delta = delta_per_step * speed_mult;
-      rolling_delta = rolling_delta*0.99 + delta*0.01;
-
-      //Apply chaos
-      for (int step = 0; step < steps; ++step) {
-        bool isOffScreen = true;
-        double x = t;
-        double y = t;
-
-        for (int iter = 0; iter < iters; ++iter) {
-          const double xx = x * x;
-          const double yy = y * y;
-          const double tt = t * t;
-          const double xy = x * y;
-          const double xt = x * t;
-          const double yt = y * t;
-          const double nx = xx*params[0] + yy*params[1] + tt*params[2] + xy*params[3] + xt*params[4] + yt*params[5] + x*params[6] + y*params[7] + t*params[8];
-          const double ny = xx*params[9] + yy*params[10] + tt*params[11] + xy*params[12] + xt*params[13] + yt*params[14] + x*params[15] + y*params[16] + t*params[17];
-          x = nx;
-          y = ny;
-          VertexPos screenPt = ToScreen(x, y);
-          if (iteration_limit && iter < 100) {
-            screenPt.x = FLT_MAX;
-            screenPt.y = FLT_MAX;
-          }
-          vertex_pos[step*iters + iter] = screenPt;
-
-          //Check if dynamic delta should be adjusted
-          if (screenPt.x > 0.0f && screenPt.y > 0.0f && screenPt.x < window_w && screenPt.y < window_h) {
-            const float dx = history[iter].x - float(x);
-            const float dy = history[iter].y - float(y);
-            const double dist = double(500.0f * std::sqrt(dx*dx + dy*dy));
-            rolling_delta = std::min(rolling_delta, std::max(delta / (dist + 1e-5), delta_minimum*speed_mult));
-            isOffScreen = false;
+      //Switch to binning when one pixel points pile up (with some hysteresis)
+      if (allow_density_bins && dot_type == 0) {
+        const double density = PointDensity(point_bounds, vertex_count, resolution_scaler.scale());
+        density_frame = density >= (density_frame ? density_bins_off : density_bins_on);
+      } else {
+        density_frame = false;
+      }
+      vertex_pos = density_frame ? density_points.data() : static_cast<VertexPos*>(vertex_stream.acquire());
+      const glm::vec4 view = ViewTransform();
+      const glm::vec4 quant = QuantWindow(view);
+
+      //Step back through recent frames, or forward again until caught up
+      CollectFrames(speed_mult < 0.0);
+      bool ring_frame = false;
+      if (!frame_ring.empty() && (speed_mult < 0.0 || ring_pos > 0.0)) {
+        ring_pos = std::max(0.0, ring_pos - speed_mult);
+        if (ring_pos >= double(frame_ring.size())) {
+          //Past the horizon, recompute backwards from the oldest frame
+          const PackedFrame& oldest = frame_ring.at_age(frame_ring.size() - 1);
+          UnpackFrame(oldest, iters, frame_points);
+          std::copy(frame_points.end() - iters, frame_points.end(), history.begin());
+          t = oldest.t;
+          rolling_delta = oldest.rolling_delta;
+          frame_ring.clear();
+          ring_pos = 0.0;
+        } else if (ring_pos > 0.0) {
+          const PackedFrame& frame = frame_ring.at_age(size_t(ring_pos));
+          UnpackFrame(frame, iters, frame_points);
+          EmitPoints(frame_points, iteration_limit, quant, vertex_pos, point_bounds);
+          shown_t = frame.t;
+          ring_frame = true;
+        }
+      }
+
+      if (!ring_frame) {
+        //Replay the cached pass while running at normal speed
+        if (cache_replaying && (speed_mult != 1.0 || cache_cursor == sweep_cache.size())) {
+          cache_replaying = false;
+          if (cache_cursor == sweep_cache.size()) {
+            history = sweep_cache.resume_history();
+          } else if (cache_cursor > 0) {
+            std::copy(frame_points.end() - iters, frame_points.end(), history.begin());
           }
-          history[iter].x = float(x);
-          history[iter].y = float(y);
+        }
+        if (cache_recording && speed_mult != 1.0) {
+          ResetSweepCache();
         }
 
-        //Update the t variable
-        if (isOffScreen) {
-          t += 0.01;
+        if (cache_replaying) {
+          const PackedFrame& frame = sweep_cache.frame(cache_cursor++);
+          UnpackFrame(frame, iters, frame_points);
+          EmitPoints(frame_points, iteration_limit, quant, vertex_pos, point_bounds);
+          t = frame.t;
+          rolling_delta = frame.rolling_delta;
+          frame_ring.push(PackedFrame(frame));
         } else {
-          t += rolling_delta;
+          //Smooth out the stepping speed, and apply chaos
+          const bool encoding = cache_recording || speed_mult > 0.0;
+          if (encoding) {
+            frame_encoder.begin();
+          }
+          StepChaos(params, speed_mult, iteration_limit, view, quant, t, rolling_delta, history,
+                    point_bounds, vertex_pos, encoding ? &frame_encoder : nullptr);
+
+          //Keep the frame for reversing, and for the next pass until the memory budget runs out
+          if (encoding) {
+            frame_encoder.submit(t, rolling_delta, history, cache_recording, speed_mult > 0.0);
+          }
+
+          //Checkpoint the state every so often, so this t can be sought back to
+          if (speed_mult == 1.0 && ++live_frames % checkpoint_interval == 0) {
+            checkpoint_index.record(Checkpoint{t, rolling_delta, plot_scale, plot_x, plot_y, history});
+          }
         }
+
+        shown_t = t;
       }
 
-      //Draw new points
-      static const float dot_sizes[] = { 1.0f, 3.0f, 10.0f };
-      // glEnable(GL_POINT_SMOOTH); // not supported
-      glPointSize(dot_sizes[dot_type]);
+      //Track where the points are, and follow them if auto-framing
+      point_bounds.commit(frame_decay);
+      if (auto_frame) {
+        SmoothFramePlot(point_bounds);
+      }
 
       NewFrame();
-      //Draw to buffer
-      glBindFramebuffer(GL_FRAMEBUFFER, fb);
-      glViewport(0, 0, window_w, window_h);
 
-      //Draw previous frame (darked a little)
-      trail_shader.use();
+      //Pan and zoom with the mouse, the shader re-projects this frame's points
+      if (!session_player.is_open() && PanZoomPlot()) {
+        view_moved = true;
+      }
+
+      //Draw to buffer, at the scaled resolution (keeping the trails when only the scale changed)
+      const float res_scale = resolution_scaler.scale();
+      const int target_w = std::max(1, int(window_w * res_scale + 0.5f));
+      const int target_h = std::max(1, int(window_h * res_scale + 0.5f));
+      if (trail_buffers.width() != target_w || trail_buffers.height() != target_h) {
+        if (res_scale != trail_scale) {
+          trail_buffers.rescale(target_w, target_h);
+        } else {
+          trail_buffers.resize(target_w, target_h);
+        }
+        trail_scale = res_scale;
+      }
+      gl_state.bind_framebuffer(GL_FRAMEBUFFER, trail_buffers.target_framebuffer());
+      gl_state.viewport(0, 0, trail_buffers.width(), trail_buffers.height());
+
       float fade_speeds[] = { 10/255.f,2/255.f, 0.0f , 1.0f };
-      trail_shader.uniformf("colour_scale", {fade_speeds[trail_type]});
-      glBindVertexArray(trails);
-      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+      float decay_rates[] = { 0.85f, 0.97f, 1.0f, 0.0f };
+      const float decay = decay_rates[trail_type];
+
+      //Decay lazily: rather than fading every pixel each frame, new points are
+      //weighted by decay^-age and the present pass scales back down by decay^age.
+      //A fade pass (rebase) only runs when the weights get too big or the rate changes.
+      //Decided up front, as this frame's point weights depend on it.
+      bool clear_trails = false;
+      bool rebase = false;
+      float rebase_decay = 1.0f;
+      float rebase_age = 0.0f;
+      if (trail_buffers.hdr()) {
+        if (decay == 0.0f) {
+          clear_trails = true;
+          decay_age = 0;
+        } else if (decay_age > 0 && (decay != decay_epoch_rate ||
+                                     std::pow(decay, -float(decay_age)) > max_decay_weight)) {
+          rebase = true;
+          rebase_decay = std::pow(decay_epoch_rate, float(decay_age));
+          rebase_age = float(decay_age);
+          decay_age = 0;
+        }
+        decay_epoch_rate = decay;
+      }
+
+      //Dots are sized in screen pixels, and keep their brightness when the target
+      //is too coarse for them (points are at least a pixel)
+      static const float dot_sizes[] = { 1.0f, 3.0f, 10.0f };
+      const float dot_size = dot_sizes[dot_type] * res_scale;
+      const float dot_coverage = std::min(1.0f, dot_size * dot_size);
+      const float point_weight = dot_coverage * (trail_buffers.hdr() ? std::pow(decay, -float(decay_age)) : 1.0f);
+      const float point_stamp = trail_buffers.hdr() ? float(decay_age) : -1.0f;
+      const glm::vec4 draw_view = ViewTransform();
+
+      FrameParams frame;
+      frame.view = draw_view;
+      frame.quant = quant;
+      frame.target_size[0] = float(trail_buffers.width());
+      frame.target_size[1] = float(trail_buffers.height());
+      frame.fade = fade_speeds[trail_type];
+      frame.point_size = std::max(1.0f, dot_size);
+      frame.weight = point_weight;
+      frame.stamp = point_stamp;
+      frame.iters = iters;
+      frame.padding = 0;
+      frame_params.update(frame);
+
+      gpu_profiler.begin("trail");
+      if (clear_trails) {
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+      } else if (rebase) {
+        trail_buffers.swap();
+        gl_state.bind_framebuffer(GL_FRAMEBUFFER, trail_buffers.target_framebuffer());
+        gl_state.bind_texture(GL_TEXTURE_2D, trail_buffers.source_texture());
+        rebase_shader.use();
+        rebase_decay_uniform.set(rebase_decay);
+        rebase_age_uniform.set(rebase_age);
+        gl_state.bind_vertex_array(trails);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+      } else if (!trail_buffers.hdr()) {
+        //Draw previous frame (darked a little)
+        gl_state.bind_texture(GL_TEXTURE_2D, trail_buffers.source_texture());
+        trail_shader.use();
+        gl_state.bind_vertex_array(trails);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+      }
+      gpu_profiler.end();
 
       //Draw current points
-      glEnable(GL_BLEND);
-      glEnable(GL_PROGRAM_POINT_SIZE);
-      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-      point_shader.use();
-      point_shader.uniformi("window_w", {window_w});
-      point_shader.uniformi("window_h", {window_h});
-      UpdateVertexBuffers();
-      glBindVertexArray(vertices);
-      glDrawArrays(GL_POINTS, 0, vertex_pos.size());
-
-      //Draw to screen
-      glDisable(GL_BLEND);
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
-      trail_shader.use();
-      trail_shader.uniformf("colour_scale", {0.0f});
-      glViewport(0, 0, window_w, window_h);
-      glBindVertexArray(trails);
-      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+      gpu_profiler.begin("points");
+      gl_state.enable(GL_BLEND);
+      gl_state.enable(GL_PROGRAM_POINT_SIZE);
+      if (trail_buffers.hdr()) {
+        //Add the weighted colour, keep the latest write time in alpha
+        gl_state.blend_func_separate(GL_ONE, GL_ONE, GL_ONE, GL_ONE);
+        gl_state.blend_equation_separate(GL_FUNC_ADD, GL_MAX);
+      } else if (density_frame) {
+        gl_state.blend_func(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+      } else {
+        gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      }
+
+      if (density_frame) {
+        //Bin them, and composite the touched rectangle in one pass
+        if (density_binner.width() != trail_buffers.width() || density_binner.height() != trail_buffers.height()) {
+          density_binner.resize(trail_buffers.width(), trail_buffers.height());
+        }
+        density_binner.bin(density_points.data(), vertex_count, quant, draw_view);
+        if (density_binner.upload()) {
+          gl_state.enable(GL_SCISSOR_TEST);
+          gl_state.scissor(density_binner.min_col(), density_binner.min_row(),
+                           density_binner.max_col() - density_binner.min_col(),
+                           density_binner.max_row() - density_binner.min_row());
+          density_shader.use();
+          gl_state.bind_vertex_array(trails);
+          glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+          gl_state.disable(GL_SCISSOR_TEST);
+        }
+      } else {
+        ShaderProgram& point_shader = (dot_type == 0) ? point_pixel_shader : point_disc_shader;
+        point_shader.use();
+        const GLint first_vertex = vertex_stream.submit();
+        gl_state.bind_vertex_array(vertices);
+        glDrawArrays(GL_POINTS, first_vertex, vertex_count);
+        vertex_stream.fence();
+      }
+      gpu_profiler.end();
+
+      //Draw to screen (tone mapped when accumulating HDR)
+      gpu_profiler.begin("present");
+      gl_state.blend_equation(GL_FUNC_ADD);
+      gl_state.disable(GL_BLEND);
+      if (trail_buffers.hdr()) {
+        const float fade = std::pow(decay, float(decay_age));
+        const float exposure = auto_exposure.update(trail_buffers.target_texture(),
+                                                    trail_buffers.width(), trail_buffers.height(), fade);
+        const bool decaying = decay > 0.0f && decay < 1.0f;
+        gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+        gl_state.viewport(0, 0, window_w, window_h);
+        gl_state.bind_texture(GL_TEXTURE_2D, trail_buffers.target_texture());
+        present_shader.use();
+        present_exposure_uniform.set(exposure * fade);
+        present_tone_map_uniform.set(tone_map);
+        present_now_uniform.set(float(decay_age));
+        present_cutoff_uniform.set(decaying ? std::log(decay_visible_floor) / std::log(decay) : 1e9f);
+        gl_state.bind_vertex_array(trails);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        if (decaying) {
+          decay_age += 1;
+        }
+      } else {
+        gl_state.bind_framebuffer(GL_READ_FRAMEBUFFER, trail_buffers.target_framebuffer());
+        gl_state.bind_framebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, trail_buffers.width(), trail_buffers.height(),
+                          0, 0, window_w, window_h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+        gl_state.viewport(0, 0, window_w, window_h);
+        trail_buffers.swap();
+      }
+      gpu_profiler.end();
+
+      //Screenshots are of the plot alone (before the UI), read back over the next frames
+      if (take_screenshot) {
+        std::ostringstream tag;
+        tag << equ_code << "_t" << std::fixed << std::setprecision(6) << shown_t;
+        gl_state.bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
+        if (!screenshots.capture(window_w, window_h, tag.str())) {
+          std::cout << "Screenshot skipped, earlier ones are still being read back" << std::endl;
+        }
+        take_screenshot = false;
+      }
+      screenshots.poll();
 
       //Draw the equation
       RenderEquation();
 
       //Draw the current t-value
-      MakeTText(t);
+      double seek_t;
+      if (MakeTText(shown_t, checkpoint_index.max_t(), seek_t) && !session_player.is_open()) {
+        pending_seek = true;
+        pending_seek_t = seek_t;
+      }
+
+      if (show_profiler) {
+        MakeProfilerPanel(gpu_profiler, trail_scale, gl_frame_calls,
+                          density_frame ? density_binner.upload_bytes() : 0, vertex_count * sizeof(VertexPos));
+      }
 
       //Render UI
       ImGui::Render();
+      gpu_profiler.begin("imgui");
       ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      gpu_profiler.end();
 
       //Flip the screen buffer
       glfwSwapBuffers(window);
+      if (!startup.done()) {
+        startup.first_frame();
+        if (args.count("startup-profile")) {
+          startup.report(std::cout);
+          if (program_cache.enabled()) {
+            std::cout << "Programs: " << program_cache.hits() << " from the binary cache, "
+                      << program_cache.misses() << " compiled" << std::endl;
+          }
+          std::cout << "Parallel shader compile: " << (gl_ext.parallel_shader_compile ? "yes" : "no") << std::endl;
+        }
+      }
+      gpu_profiler.next_frame();
+      gl_frame_calls = gl_state.counters();
+      gl_state.reset_counters();
+      double gpu_ms;
+      if (gpu_profiler.last_frame_ms(gpu_ms)) {
+        resolution_scaler.add_frame(gpu_ms);
+      }
 
       if (load_started) {
         std::string code;
-        std::cout << "Enter 6 letter code:" << std::endl;
-        std::cin >> code;
-        ResetPlot();
-        StringToParams(code, params);
-        GenerateNew(window, t, params);
+        if (session_player.is_open()) {
+          SessionRecord record;
+          if (session_player.next(record) && record.type == SessionEvent::Load) {
+            code = record.code;
+          } else {
+            std::cout << "Session log is missing a loaded code" << std::endl;
+          }
+        } else {
+          std::cout << "Enter 6 letter code:" << std::endl;
+          std::cin >> code;
+          if (session_recorder.is_open()) {
+            session_recorder.load(code);
+          }
+        }
+        LoadEquation(code);
         load_started = false;
       }
     }
+
+    if (session_player.is_open()) {
+      const double elapsed = glfwGetTime() - replay_start;
+      std::cout << "Replayed " << replayed_frames << " frames in " << elapsed << "s ("
+                << replayed_frames / std::max(elapsed, 1e-9) << " fps)" << std::endl;
+    }
+
+    //Remember where we got to (not for replays, which leave no trace)
+    if (!session_player.is_open()) {
+      checkpoint_index.keep();
+      checkpoint_index.save();
+      std::error_code error;
+      std::filesystem::create_directories(checkpoint_dir, error);
+      std::ofstream session(session_file);
+      session << ParamsToString(params) << " " << shown_t << std::endl;
+    }
   }
-  glfwTerminate();
   return 0;
 }
@@ -11,6 +11,10 @@
 // If you are new to dear imgui, read examples/README.txt and read the documentation at the top of imgui.cpp.
 // https://github.com/ocornut/imgui
 
+// LOCAL MODIFICATION (Chaos Equations, not upstream): on Desktop GL 3.2+ the vertex/index data of a frame is streamed through
+// growable ring buffers guarded by a fence per frame, instead of reallocating the buffers for every command list.
+// See ImGui_ImplOpenGL3_UploadStreamFrame(). Keep this when updating the file from upstream.
+
 // CHANGELOG
 // (minor and older changes stripped away, please see git history for details)
 //  2020-07-10: OpenGL: Added support for glad2 OpenGL loader.
@@ -102,6 +106,7 @@
 #include <GL/glew.h>            // Needs to be initialized with glewInit() in user's code.
 #elif defined(IMGUI_IMPL_OPENGL_LOADER_GLAD)
 #include <glad/glad.h>          // Needs to be initialized with gladLoadGL() in user's code.
+#include "gl_state.h"           // Binds and state backups go through the app's state cache
 #elif defined(IMGUI_IMPL_OPENGL_LOADER_GLAD2)
 #include <glad/gl.h>            // Needs to be initialized with gladLoadGL(...) or gladLoaderLoadGL() in user's code.
 #elif defined(IMGUI_IMPL_OPENGL_LOADER_GLBINDING2)
@@ -139,6 +144,124 @@ static GLint        g_AttribLocationTex = 0, g_AttribLocationProjMtx = 0;
 static GLuint       g_AttribLocationVtxPos = 0, g_AttribLocationVtxUV = 0, g_AttribLocationVtxColor = 0; // Vertex attributes location
 static unsigned int g_VboHandle = 0, g_ElementsHandle = 0;
 
+#if IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
+// Stream buffers (Desktop GL 3.2+ only): every frame's command lists are sub-allocated back to back from a vertex and an index ring
+// that only ever grow, and drawn through base-vertex offsets. A fence per frame guards the ring region the GPU may still be reading.
+struct ImGui_ImplOpenGL3_StreamFrame
+{
+    int     VtxStart, VtxEnd, IdxStart, IdxEnd;
+    GLsync  Fence;
+};
+static int          g_VtxCapacity = 0, g_IdxCapacity = 0;   // Ring sizes, in vertices / indices
+static int          g_VtxHead = 0, g_IdxHead = 0;           // Next free element in each ring
+static ImVector<ImGui_ImplOpenGL3_StreamFrame> g_StreamFrames;
+
+// Returns where to write 'count' elements in a ring, wrapping to the start when they don't fit before its end
+static int ImGui_ImplOpenGL3_RingAlloc(int& head, int capacity, int count)
+{
+    if (head + count > capacity)
+        head = 0;
+    int start = head;
+    head += count;
+    return start;
+}
+
+static void ImGui_ImplOpenGL3_ReleaseStreamFrames()
+{
+    for (int i = 0; i < g_StreamFrames.Size; i++)
+        glDeleteSync(g_StreamFrames[i].Fence);
+    g_StreamFrames.clear();
+}
+
+// Drops the current rings (and their fences) for fresh storage, the driver frees the old one once the GPU is done with it.
+// Expects the stream buffers to be bound.
+static void ImGui_ImplOpenGL3_OrphanStreamBuffers()
+{
+    ImGui_ImplOpenGL3_ReleaseStreamFrames();
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)g_VtxCapacity * (int)sizeof(ImDrawVert), NULL, GL_STREAM_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)g_IdxCapacity * (int)sizeof(ImDrawIdx), NULL, GL_STREAM_DRAW);
+    g_VtxHead = g_IdxHead = 0;
+}
+
+// Waits until the GPU is done with every older frame overlapping the ranges about to be written.
+// Frames are kept oldest first and recycled in ring order, so everything up to the last overlapping one is retired.
+// Returns false if a wait timed out or failed, the ranges may still be in use then.
+static bool ImGui_ImplOpenGL3_RetireStreamFrames(int vtx_start, int vtx_end, int idx_start, int idx_end)
+{
+    int last_overlap = -1;
+    for (int i = 0; i < g_StreamFrames.Size; i++)
+    {
+        const ImGui_ImplOpenGL3_StreamFrame& frame = g_StreamFrames[i];
+        if ((frame.VtxStart < vtx_end && vtx_start < frame.VtxEnd) || (frame.IdxStart < idx_end && idx_start < frame.IdxEnd))
+            last_overlap = i;
+    }
+    bool idle = true;
+    for (int i = 0; i <= last_overlap; i++)
+    {
+        GLenum result = glClientWaitSync(g_StreamFrames[i].Fence, GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)1000000000);
+        if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+            idle = false;
+        glDeleteSync(g_StreamFrames[i].Fence);
+    }
+    if (last_overlap >= 0)
+        g_StreamFrames.erase(g_StreamFrames.begin(), g_StreamFrames.begin() + last_overlap + 1);
+    return idle;
+}
+
+// Copies all command lists of the frame into the rings (growing them when the frame doesn't leave room for a few more in flight).
+// Returns false when there is nothing to upload. Expects the stream buffers to be bound.
+static bool ImGui_ImplOpenGL3_UploadStreamFrame(ImDrawData* draw_data, int* out_vtx_start, int* out_idx_start)
+{
+    const int total_vtx = draw_data->TotalVtxCount;
+    const int total_idx = draw_data->TotalIdxCount;
+    if (total_vtx <= 0 || total_idx <= 0)
+        return false;
+
+    // Grow geometrically so steady state never reallocates. The old storage is orphaned, the driver frees it once the GPU is done.
+    if (total_vtx * 3 > g_VtxCapacity || total_idx * 3 > g_IdxCapacity)
+    {
+        while (total_vtx * 3 > g_VtxCapacity)
+            g_VtxCapacity = g_VtxCapacity ? g_VtxCapacity * 2 : 4096;
+        while (total_idx * 3 > g_IdxCapacity)
+            g_IdxCapacity = g_IdxCapacity ? g_IdxCapacity * 2 : 8192;
+        ImGui_ImplOpenGL3_OrphanStreamBuffers();
+    }
+
+    int vtx_start = ImGui_ImplOpenGL3_RingAlloc(g_VtxHead, g_VtxCapacity, total_vtx);
+    int idx_start = ImGui_ImplOpenGL3_RingAlloc(g_IdxHead, g_IdxCapacity, total_idx);
+    if (!ImGui_ImplOpenGL3_RetireStreamFrames(vtx_start, vtx_start + total_vtx, idx_start, idx_start + total_idx))
+    {
+        // The GPU may still be reading those ranges, write to fresh storage rather than over them
+        ImGui_ImplOpenGL3_OrphanStreamBuffers();
+        vtx_start = ImGui_ImplOpenGL3_RingAlloc(g_VtxHead, g_VtxCapacity, total_vtx);
+        idx_start = ImGui_ImplOpenGL3_RingAlloc(g_IdxHead, g_IdxCapacity, total_idx);
+    }
+
+    // The range is known to be idle, so map it without the driver synchronizing against the rest of the buffer
+    const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    ImDrawVert* vtx_dst = (ImDrawVert*)glMapBufferRange(GL_ARRAY_BUFFER, (GLintptr)vtx_start * (int)sizeof(ImDrawVert), (GLsizeiptr)total_vtx * (int)sizeof(ImDrawVert), access);
+    ImDrawIdx* idx_dst = (ImDrawIdx*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)idx_start * (int)sizeof(ImDrawIdx), (GLsizeiptr)total_idx * (int)sizeof(ImDrawIdx), access);
+    if (vtx_dst && idx_dst)
+    {
+        for (int n = 0; n < draw_data->CmdListsCount; n++)
+        {
+            const ImDrawList* cmd_list = draw_data->CmdLists[n];
+            memcpy(vtx_dst, cmd_list->VtxBuffer.Data, (size_t)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+            memcpy(idx_dst, cmd_list->IdxBuffer.Data, (size_t)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+            vtx_dst += cmd_list->VtxBuffer.Size;
+            idx_dst += cmd_list->IdxBuffer.Size;
+        }
+    }
+    bool intact = (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE) & (glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) == GL_TRUE);
+    if (!vtx_dst || !idx_dst || !intact)
+        return false; // Mapping failed or the store got corrupted (e.g. mode switch), skip the overlay for this frame
+
+    *out_vtx_start = vtx_start;
+    *out_idx_start = idx_start;
+    return true;
+}
+#endif
+
 // Functions
 bool    ImGui_ImplOpenGL3_Init(const char* glsl_version)
 {
@@ -227,14 +350,14 @@ void    ImGui_ImplOpenGL3_NewFrame()
 static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_width, int fb_height, GLuint vertex_array_object)
 {
     // Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled, polygon fill
-    glEnable(GL_BLEND);
-    glBlendEquation(GL_FUNC_ADD);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_SCISSOR_TEST);
+    gl_state.enable(GL_BLEND);
+    gl_state.blend_equation(GL_FUNC_ADD);
+    gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state.disable(GL_CULL_FACE);
+    gl_state.disable(GL_DEPTH_TEST);
+    gl_state.enable(GL_SCISSOR_TEST);
 #ifdef GL_POLYGON_MODE
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    gl_state.polygon_mode(GL_FILL);
 #endif
 
     // Support for GL 4.5 rarely used glClipControl(GL_UPPER_LEFT)
@@ -247,7 +370,7 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
 
     // Setup viewport, orthographic projection matrix
     // Our visible imgui space lies from draw_data->DisplayPos (top left) to draw_data->DisplayPos+data_data->DisplaySize (bottom right). DisplayPos is (0,0) for single viewport apps.
-    glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
+    gl_state.viewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
     float L = draw_data->DisplayPos.x;
     float R = draw_data->DisplayPos.x + draw_data->DisplaySize.x;
     float T = draw_data->DisplayPos.y;
@@ -260,21 +383,21 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
         { 0.0f,         0.0f,        -1.0f,   0.0f },
         { (R+L)/(L-R),  (T+B)/(B-T),  0.0f,   1.0f },
     };
-    glUseProgram(g_ShaderHandle);
+    gl_state.use_program(g_ShaderHandle);
     glUniform1i(g_AttribLocationTex, 0);
     glUniformMatrix4fv(g_AttribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
 #ifdef GL_SAMPLER_BINDING
-    glBindSampler(0, 0); // We use combined texture/sampler state. Applications using GL 3.3 may set that otherwise.
+    gl_state.bind_sampler(0, 0); // We use combined texture/sampler state. Applications using GL 3.3 may set that otherwise.
 #endif
 
     (void)vertex_array_object;
 #ifndef IMGUI_IMPL_OPENGL_ES2
-    glBindVertexArray(vertex_array_object);
+    gl_state.bind_vertex_array(vertex_array_object);
 #endif
 
     // Bind vertex/index buffers and setup attributes for ImDrawVert
-    glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, g_VboHandle);
+    gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
     glEnableVertexAttribArray(g_AttribLocationVtxPos);
     glEnableVertexAttribArray(g_AttribLocationVtxUV);
     glEnableVertexAttribArray(g_AttribLocationVtxColor);
@@ -294,33 +417,29 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
     if (fb_width <= 0 || fb_height <= 0)
         return;
 
-    // Backup GL state
-    GLenum last_active_texture; glGetIntegerv(GL_ACTIVE_TEXTURE, (GLint*)&last_active_texture);
-    glActiveTexture(GL_TEXTURE0);
-    GLuint last_program; glGetIntegerv(GL_CURRENT_PROGRAM, (GLint*)&last_program);
-    GLuint last_texture; glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*)&last_texture);
+    // Backup GL state (from the state cache, without querying the driver)
+    GLenum last_active_texture = gl_state.active_texture();
+    gl_state.active_texture(GL_TEXTURE0);
+    GLuint last_program = gl_state.program();
+    GLuint last_texture = gl_state.texture();
 #ifdef GL_SAMPLER_BINDING
-    GLuint last_sampler; glGetIntegerv(GL_SAMPLER_BINDING, (GLint*)&last_sampler);
+    GLuint last_sampler = gl_state.sampler(0);
 #endif
-    GLuint last_array_buffer; glGetIntegerv(GL_ARRAY_BUFFER_BINDING, (GLint*)&last_array_buffer);
+    GLuint last_array_buffer = gl_state.array_buffer();
 #ifndef IMGUI_IMPL_OPENGL_ES2
-    GLuint last_vertex_array_object; glGetIntegerv(GL_VERTEX_ARRAY_BINDING, (GLint*)&last_vertex_array_object);
+    GLuint last_vertex_array_object = gl_state.vertex_array();
 #endif
 #ifdef GL_POLYGON_MODE
-    GLint last_polygon_mode[2]; glGetIntegerv(GL_POLYGON_MODE, last_polygon_mode);
-#endif
-    GLint last_viewport[4]; glGetIntegerv(GL_VIEWPORT, last_viewport);
-    GLint last_scissor_box[4]; glGetIntegerv(GL_SCISSOR_BOX, last_scissor_box);
-    GLenum last_blend_src_rgb; glGetIntegerv(GL_BLEND_SRC_RGB, (GLint*)&last_blend_src_rgb);
-    GLenum last_blend_dst_rgb; glGetIntegerv(GL_BLEND_DST_RGB, (GLint*)&last_blend_dst_rgb);
-    GLenum last_blend_src_alpha; glGetIntegerv(GL_BLEND_SRC_ALPHA, (GLint*)&last_blend_src_alpha);
-    GLenum last_blend_dst_alpha; glGetIntegerv(GL_BLEND_DST_ALPHA, (GLint*)&last_blend_dst_alpha);
-    GLenum last_blend_equation_rgb; glGetIntegerv(GL_BLEND_EQUATION_RGB, (GLint*)&last_blend_equation_rgb);
-    GLenum last_blend_equation_alpha; glGetIntegerv(GL_BLEND_EQUATION_ALPHA, (GLint*)&last_blend_equation_alpha);
-    GLboolean last_enable_blend = glIsEnabled(GL_BLEND);
-    GLboolean last_enable_cull_face = glIsEnabled(GL_CULL_FACE);
-    GLboolean last_enable_depth_test = glIsEnabled(GL_DEPTH_TEST);
-    GLboolean last_enable_scissor_test = glIsEnabled(GL_SCISSOR_TEST);
+    GLenum last_polygon_mode = gl_state.polygon_mode();
+#endif
+    GLint last_viewport[4]; gl_state.get_viewport(last_viewport);
+    GLint last_scissor_box[4]; gl_state.get_scissor(last_scissor_box);
+    GLenum last_blend_func[4]; gl_state.get_blend_func(last_blend_func);
+    GLenum last_blend_equation[2]; gl_state.get_blend_equation(last_blend_equation);
+    bool last_enable_blend = gl_state.is_enabled(GL_BLEND);
+    bool last_enable_cull_face = gl_state.is_enabled(GL_CULL_FACE);
+    bool last_enable_depth_test = gl_state.is_enabled(GL_DEPTH_TEST);
+    bool last_enable_scissor_test = gl_state.is_enabled(GL_SCISSOR_TEST);
 
     // Setup desired GL state
     // Recreate the VAO every time (this is to easily allow multiple GL contexts to be rendered to. VAO are not shared among GL contexts)
@@ -331,18 +450,35 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
 #endif
     ImGui_ImplOpenGL3_SetupRenderState(draw_data, fb_width, fb_height, vertex_array_object);
 
+    // Upload the whole frame into the stream buffers up front, each list is then drawn at its offset within them
+    bool use_stream_buffers = false;
+    int cmd_lists_count = draw_data->CmdListsCount;
+    int list_vtx_start = 0, list_idx_start = 0;
+#if IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
+    if (g_GlVersion >= 320)
+    {
+        use_stream_buffers = true;
+        if (!ImGui_ImplOpenGL3_UploadStreamFrame(draw_data, &list_vtx_start, &list_idx_start))
+            cmd_lists_count = 0;
+    }
+#endif
+    const int frame_vtx_start = list_vtx_start, frame_idx_start = list_idx_start;
+
     // Will project scissor/clipping rectangles into framebuffer space
     ImVec2 clip_off = draw_data->DisplayPos;         // (0,0) unless using multi-viewports
     ImVec2 clip_scale = draw_data->FramebufferScale; // (1,1) unless using retina display which are often (2,2)
 
     // Render command lists
-    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    for (int n = 0; n < cmd_lists_count; n++)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
 
-        // Upload vertex/index buffers
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * (int)sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * (int)sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        // Upload vertex/index buffers (already in the stream buffers when available)
+        if (!use_stream_buffers)
+        {
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * (int)sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * (int)sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        }
 
         for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
         {
@@ -368,48 +504,60 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
                 if (clip_rect.x < fb_width && clip_rect.y < fb_height && clip_rect.z >= 0.0f && clip_rect.w >= 0.0f)
                 {
                     // Apply scissor/clipping rectangle
-                    glScissor((int)clip_rect.x, (int)(fb_height - clip_rect.w), (int)(clip_rect.z - clip_rect.x), (int)(clip_rect.w - clip_rect.y));
+                    gl_state.scissor((int)clip_rect.x, (int)(fb_height - clip_rect.w), (int)(clip_rect.z - clip_rect.x), (int)(clip_rect.w - clip_rect.y));
 
                     // Bind texture, Draw
-                    glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
+                    gl_state.bind_texture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
 #if IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
                     if (g_GlVersion >= 320)
-                        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx)), (GLint)pcmd->VtxOffset);
+                        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)((list_idx_start + pcmd->IdxOffset) * sizeof(ImDrawIdx)), (GLint)(list_vtx_start + pcmd->VtxOffset));
                     else
 #endif
                     glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx)));
                 }
             }
         }
+        list_vtx_start += cmd_list->VtxBuffer.Size;
+        list_idx_start += cmd_list->IdxBuffer.Size;
     }
 
+#if IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
+    // Fence the frame's ring region so it isn't overwritten while the GPU still reads it
+    if (use_stream_buffers && cmd_lists_count > 0)
+    {
+        ImGui_ImplOpenGL3_StreamFrame frame = { frame_vtx_start, list_vtx_start, frame_idx_start, list_idx_start, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) };
+        g_StreamFrames.push_back(frame);
+    }
+#endif
+    (void)frame_vtx_start; (void)frame_idx_start;
+
     // Destroy the temporary VAO
 #ifndef IMGUI_IMPL_OPENGL_ES2
     glDeleteVertexArrays(1, &vertex_array_object);
 #endif
 
-    // Restore modified GL state
-    glUseProgram(last_program);
-    glBindTexture(GL_TEXTURE_2D, last_texture);
+    // Restore modified GL state (calls that change nothing are skipped)
+    gl_state.use_program(last_program);
+    gl_state.bind_texture(GL_TEXTURE_2D, last_texture);
 #ifdef GL_SAMPLER_BINDING
-    glBindSampler(0, last_sampler);
+    gl_state.bind_sampler(0, last_sampler);
 #endif
-    glActiveTexture(last_active_texture);
+    gl_state.active_texture(last_active_texture);
 #ifndef IMGUI_IMPL_OPENGL_ES2
-    glBindVertexArray(last_vertex_array_object);
-#endif
-    glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
-    glBlendEquationSeparate(last_blend_equation_rgb, last_blend_equation_alpha);
-    glBlendFuncSeparate(last_blend_src_rgb, last_blend_dst_rgb, last_blend_src_alpha, last_blend_dst_alpha);
-    if (last_enable_blend) glEnable(GL_BLEND); else glDisable(GL_BLEND);
-    if (last_enable_cull_face) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE);
-    if (last_enable_depth_test) glEnable(GL_DEPTH_TEST); else glDisable(GL_DEPTH_TEST);
-    if (last_enable_scissor_test) glEnable(GL_SCISSOR_TEST); else glDisable(GL_SCISSOR_TEST);
+    gl_state.bind_vertex_array(last_vertex_array_object);
+#endif
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, last_array_buffer);
+    gl_state.blend_equation_separate(last_blend_equation[0], last_blend_equation[1]);
+    gl_state.blend_func_separate(last_blend_func[0], last_blend_func[1], last_blend_func[2], last_blend_func[3]);
+    gl_state.set_enabled(GL_BLEND, last_enable_blend);
+    gl_state.set_enabled(GL_CULL_FACE, last_enable_cull_face);
+    gl_state.set_enabled(GL_DEPTH_TEST, last_enable_depth_test);
+    gl_state.set_enabled(GL_SCISSOR_TEST, last_enable_scissor_test);
 #ifdef GL_POLYGON_MODE
-    glPolygonMode(GL_FRONT_AND_BACK, (GLenum)last_polygon_mode[0]);
+    gl_state.polygon_mode(last_polygon_mode);
 #endif
-    glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
-    glScissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
+    gl_state.viewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
+    gl_state.scissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
 }
 
 bool ImGui_ImplOpenGL3_CreateFontsTexture()
@@ -421,10 +569,9 @@ bool ImGui_ImplOpenGL3_CreateFontsTexture()
     io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);   // Load as RGBA 32-bit (75% of the memory is wasted, but default font is so small) because it is more likely to be compatible with user's existing shaders. If your ImTextureId represent a higher-level concept than just a GL texture id, consider calling GetTexDataAsAlpha8() instead to save on GPU memory.
 
     // Upload texture to graphics system
-    GLint last_texture;
-    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    GLuint last_texture = gl_state.texture();
     glGenTextures(1, &g_FontTexture);
-    glBindTexture(GL_TEXTURE_2D, g_FontTexture);
+    gl_state.bind_texture(GL_TEXTURE_2D, g_FontTexture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 #ifdef GL_UNPACK_ROW_LENGTH
@@ -436,7 +583,7 @@ bool ImGui_ImplOpenGL3_CreateFontsTexture()
     io.Fonts->TexID = (ImTextureID)(intptr_t)g_FontTexture;
 
     // Restore state
-    glBindTexture(GL_TEXTURE_2D, last_texture);
+    gl_state.bind_texture(GL_TEXTURE_2D, last_texture);
 
     return true;
 }
@@ -491,12 +638,10 @@ static bool CheckProgram(GLuint handle, const char* desc)
 bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
 {
     // Backup GL state
-    GLint last_texture, last_array_buffer;
-    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
-    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &last_array_buffer);
+    GLuint last_texture = gl_state.texture();
+    GLuint last_array_buffer = gl_state.array_buffer();
 #ifndef IMGUI_IMPL_OPENGL_ES2
-    GLint last_vertex_array;
-    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
+    GLuint last_vertex_array = gl_state.vertex_array();
 #endif
 
     // Parse GLSL version string
@@ -659,10 +804,10 @@ bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
     ImGui_ImplOpenGL3_CreateFontsTexture();
 
     // Restore modified GL state
-    glBindTexture(GL_TEXTURE_2D, last_texture);
-    glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
+    gl_state.bind_texture(GL_TEXTURE_2D, last_texture);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, last_array_buffer);
 #ifndef IMGUI_IMPL_OPENGL_ES2
-    glBindVertexArray(last_vertex_array);
+    gl_state.bind_vertex_array(last_vertex_array);
 #endif
 
     return true;
@@ -672,6 +817,11 @@ void    ImGui_ImplOpenGL3_DestroyDeviceObjects()
 {
     if (g_VboHandle)        { glDeleteBuffers(1, &g_VboHandle); g_VboHandle = 0; }
     if (g_ElementsHandle)   { glDeleteBuffers(1, &g_ElementsHandle); g_ElementsHandle = 0; }
+#if IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
+    ImGui_ImplOpenGL3_ReleaseStreamFrames();
+    g_VtxCapacity = g_IdxCapacity = 0;
+    g_VtxHead = g_IdxHead = 0;
+#endif
     if (g_ShaderHandle && g_VertHandle) { glDetachShader(g_ShaderHandle, g_VertHandle); }
     if (g_ShaderHandle && g_FragHandle) { glDetachShader(g_ShaderHandle, g_FragHandle); }
     if (g_VertHandle)       { glDeleteShader(g_VertHandle); g_VertHandle = 0; }
@@ -0,0 +1,109 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "auto_exposure.h"
+#include "gl_state.h"
+
+static const int reduced_size = 64;
+//Mipmapping the whole target is the costly part, so only every few frames
+static const int reduce_interval = 8;
+static const int histogram_bins = 64;
+static const float min_log_lum = -16.0f;
+static const float max_log_lum = 8.0f;
+static const float exposure_percentile = 0.9f;
+static const float exposure_key = 0.8f;
+static const float exposure_smoothing = 0.05f;
+
+AutoExposure::AutoExposure()
+  : m_fences{}, m_sizes{}, m_scales{}, m_next(0), m_frame(0), m_exposure(1.0f), m_target_exposure(1.0f) {
+  glGenBuffers(num_pbos, m_pbos);
+}
+
+AutoExposure::~AutoExposure() {
+  for (GLsync fence : m_fences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  glDeleteBuffers(num_pbos, m_pbos);
+}
+
+bool AutoExposure::read(int pbo) {
+  GLsync& fence = m_fences[pbo];
+  if (!fence || glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+    return false;
+  }
+  glDeleteSync(fence);
+  fence = nullptr;
+
+  const size_t count = size_t(m_sizes[pbo][0]) * m_sizes[pbo][1] * 4;
+  m_pixels.resize(count);
+  gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, m_pbos[pbo]);
+  void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT);
+  if (data) {
+    std::memcpy(m_pixels.data(), data, count * sizeof(float));
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+  return data != nullptr;
+}
+
+float AutoExposure::update(GLuint texture, int width, int height, float scale) {
+  /* Use the oldest read back if it has landed */
+  const int pbo = m_next;
+  if (read(pbo)) {
+    int histogram[histogram_bins] = {};
+    int lit = 0;
+    for (size_t i = 0; i < m_pixels.size(); i += 4) {
+      const float lum = m_scales[pbo] *
+        (0.2126f * m_pixels[i] + 0.7152f * m_pixels[i + 1] + 0.0722f * m_pixels[i + 2]);
+      /* Overflowed sums count as saturated, converting inf to a bin is undefined */
+      if (!std::isfinite(lum)) {
+        histogram[histogram_bins - 1] += 1;
+        lit += 1;
+        continue;
+      }
+      if (!(lum > 1e-5f)) continue;
+      const float bin = (std::log2(lum) - min_log_lum) / (max_log_lum - min_log_lum) * histogram_bins;
+      histogram[std::min(histogram_bins - 1, std::max(0, int(bin)))] += 1;
+      lit += 1;
+    }
+    if (lit > 0) {
+      const int target = int(lit * exposure_percentile);
+      int cumulative = 0;
+      int bin = 0;
+      for (; bin < histogram_bins - 1 && cumulative + histogram[bin] <= target; ++bin) {
+        cumulative += histogram[bin];
+      }
+      const float log_lum = min_log_lum + (bin + 0.5f) * (max_log_lum - min_log_lum) / histogram_bins;
+      m_target_exposure = exposure_key / std::exp2(log_lum);
+    }
+  }
+  m_exposure *= std::pow(m_target_exposure / m_exposure, exposure_smoothing);
+
+  /* Reduce this frame and start reading it back into the same buffer */
+  if (m_frame++ % reduce_interval == 0 && !m_fences[pbo]) {
+    int level = 0;
+    int w = width;
+    int h = height;
+    while (std::max(w, h) > reduced_size) {
+      w = std::max(1, w / 2);
+      h = std::max(1, h / 2);
+      level += 1;
+    }
+    gl_state.bind_texture(GL_TEXTURE_2D, texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, m_pbos[pbo]);
+    if (m_sizes[pbo][0] != w || m_sizes[pbo][1] != h) {
+      glBufferData(GL_PIXEL_PACK_BUFFER, size_t(w) * h * 4 * sizeof(float), nullptr, GL_STREAM_READ);
+      m_sizes[pbo][0] = w;
+      m_sizes[pbo][1] = h;
+    }
+    m_scales[pbo] = scale;
+    glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_FLOAT, nullptr);
+    gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_fences[pbo] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_next = (m_next + 1) % num_pbos;
+  }
+  return m_exposure;
+}
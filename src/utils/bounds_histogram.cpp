@@ -0,0 +1,52 @@
+#include <algorithm>
+#include "bounds_histogram.h"
+
+BoundsHistogram::BoundsHistogram(float range, int bins)
+  : m_range(range), m_bin_scale(bins / (2.0f * range)), m_bins(bins),
+    m_frame_x(bins), m_frame_y(bins), m_x(bins), m_y(bins), m_total(0.0) {}
+
+void BoundsHistogram::commit(double decay) {
+  double total = 0.0;
+  for (int i = 0; i < m_bins; ++i) {
+    m_x[i] = m_x[i] * decay + m_frame_x[i];
+    m_y[i] = m_y[i] * decay + m_frame_y[i];
+    total += m_x[i];
+  }
+  std::fill(m_frame_x.begin(), m_frame_x.end(), 0);
+  std::fill(m_frame_y.begin(), m_frame_y.end(), 0);
+  m_total = total;
+}
+
+void BoundsHistogram::clear() {
+  std::fill(m_frame_x.begin(), m_frame_x.end(), 0);
+  std::fill(m_frame_y.begin(), m_frame_y.end(), 0);
+  std::fill(m_x.begin(), m_x.end(), 0.0);
+  std::fill(m_y.begin(), m_y.end(), 0.0);
+  m_total = 0.0;
+}
+
+float BoundsHistogram::quantile(std::vector<double> const & counts, double q) const {
+  const double target = q * m_total;
+  double cumulative = 0.0;
+  for (int i = 0; i < m_bins; ++i) {
+    if (counts[i] > 0.0 && cumulative + counts[i] >= target) {
+      /* Interpolate within the bin */
+      const double frac = std::min(1.0, std::max(0.0, (target - cumulative) / counts[i]));
+      return float((i + frac) / m_bin_scale) - m_range;
+    }
+    cumulative += counts[i];
+  }
+  return m_range;
+}
+
+bool BoundsHistogram::bounds(double lo_q, double hi_q,
+                             float& min_x, float& max_x, float& min_y, float& max_y) const {
+  if (m_total <= 0.0) {
+    return false;
+  }
+  min_x = quantile(m_x, lo_q);
+  max_x = quantile(m_x, hi_q);
+  min_y = quantile(m_y, lo_q);
+  max_y = quantile(m_y, hi_q);
+  return true;
+}
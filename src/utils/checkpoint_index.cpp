@@ -0,0 +1,128 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <cstdint>
+#include "checkpoint_index.h"
+
+static const char checkpoint_magic[4] = { 'C', 'H', 'K', '1' };
+
+template <typename T>
+static void write_pod(std::ofstream& out, T const & value) {
+  out.write(reinterpret_cast<char const *>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool read_pod(std::ifstream& in, T& value) {
+  return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+CheckpointIndex::~CheckpointIndex() {
+  if (m_writing.valid()) {
+    m_writing.wait();
+  }
+}
+
+void CheckpointIndex::open(std::string const & code) {
+  if (m_writing.valid()) {
+    m_writing.wait();
+  }
+  m_code = code;
+  m_checkpoints.clear();
+  m_dirty = false;
+  m_keep = false;
+
+  std::error_code error;
+  const uintmax_t file_size = std::filesystem::file_size(path(), error);
+  std::ifstream in(path(), std::ios::binary);
+  if (error || !in) {
+    return;
+  }
+  char magic[4];
+  uint32_t count;
+  if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, checkpoint_magic) || !read_pod(in, count)) {
+    std::cerr << "Ignoring bad checkpoint index: " << path() << '\n';
+    return;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    Checkpoint cp;
+    uint32_t history_size;
+    if (!read_pod(in, cp.t) || !read_pod(in, cp.rolling_delta) || !read_pod(in, cp.plot_scale)
+        || !read_pod(in, cp.plot_x) || !read_pod(in, cp.plot_y) || !read_pod(in, history_size)) {
+      break;
+    }
+    const uintmax_t remaining = file_size - uintmax_t(in.tellg());
+    if (history_size > remaining / sizeof(glm::vec2)) {
+      std::cerr << "Ignoring bad checkpoint index: " << path() << '\n';
+      break;
+    }
+    cp.history.resize(history_size);
+    if (!in.read(reinterpret_cast<char*>(cp.history.data()), history_size * sizeof(glm::vec2))) {
+      break;
+    }
+    m_checkpoints.push_back(std::move(cp));
+  }
+}
+
+static void WriteIndex(std::string const & dir, std::string const & file, std::vector<Checkpoint> const & checkpoints) {
+  std::error_code error;
+  std::filesystem::create_directories(dir, error);
+  /* Written aside and renamed, so a crash never leaves half a file behind */
+  const std::string temp = file + ".tmp";
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      std::cerr << "Could not write checkpoint index: " << file << '\n';
+      return;
+    }
+    out.write(checkpoint_magic, sizeof(checkpoint_magic));
+    write_pod(out, uint32_t(checkpoints.size()));
+    for (Checkpoint const & cp : checkpoints) {
+      write_pod(out, cp.t);
+      write_pod(out, cp.rolling_delta);
+      write_pod(out, cp.plot_scale);
+      write_pod(out, cp.plot_x);
+      write_pod(out, cp.plot_y);
+      write_pod(out, uint32_t(cp.history.size()));
+      out.write(reinterpret_cast<char const *>(cp.history.data()), cp.history.size() * sizeof(glm::vec2));
+    }
+    if (!out) {
+      std::cerr << "Could not write checkpoint index: " << file << '\n';
+      out.close();
+      std::filesystem::remove(temp, error);
+      return;
+    }
+  }
+  std::filesystem::rename(temp, file, error);
+}
+
+void CheckpointIndex::save() {
+  if (!m_dirty || !m_keep || m_code.empty()) {
+    return;
+  }
+  if (m_writing.valid()) {
+    m_writing.wait();
+  }
+  m_writing = std::async(std::launch::async, WriteIndex, m_dir, path(), m_checkpoints);
+  m_dirty = false;
+}
+
+void CheckpointIndex::record(Checkpoint&& checkpoint) {
+  if (checkpoint.t <= max_t()) {
+    return;
+  }
+  m_checkpoints.push_back(std::move(checkpoint));
+  m_dirty = true;
+}
+
+Checkpoint const * CheckpointIndex::find(double t) const {
+  if (m_checkpoints.empty()) {
+    return nullptr;
+  }
+  auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), t,
+    [](double t, Checkpoint const & cp) { return t < cp.t; });
+  if (it != m_checkpoints.begin()) {
+    --it;
+  }
+  return &*it;
+}
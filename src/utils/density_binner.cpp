@@ -0,0 +1,224 @@
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "density_binner.h"
+#include "gl_state.h"
+
+static const int max_threads = 8;
+
+static int BinningThreads(int threads) {
+  return threads > 0 ? threads : std::min(max_threads, std::max(1, int(std::thread::hardware_concurrency())));
+}
+
+/* Round to the nearest half float, sums too big for one saturate at the largest */
+static inline uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+  bits &= 0x7fffffff;
+  if (bits > 0x477fe000) {
+    return sign | 0x7bff;
+  }
+  if (bits < 0x38800000) {
+    float magnitude;
+    std::memcpy(&magnitude, &bits, sizeof(bits));
+    return sign | uint16_t(std::lrint(magnitude * 16777216.0f));
+  }
+  bits += 0xfff + ((bits >> 13) & 1);
+  return sign | uint16_t((bits - 0x38000000) >> 13);
+}
+
+DensityBinner::DensityBinner(int threads)
+  : m_threads(BinningThreads(threads)), m_pool(BinningThreads(threads) - 1),
+    m_width(0), m_height(0), m_texture_size{}, m_binned(0), m_upload_bytes(0) {
+  m_tiles.resize(m_threads, std::vector<std::vector<BinnedPoint>>(m_threads));
+  m_tile_rows.assign(m_threads * 2, 0);
+  m_thread_cols.assign(m_threads * 2, 0);
+
+  glGenTextures(1, &m_texture);
+  gl_state.bind_texture(GL_TEXTURE_2D, m_texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+DensityBinner::~DensityBinner() {
+  glDeleteTextures(1, &m_texture);
+}
+
+void DensityBinner::resize(int width, int height) {
+  m_width = width;
+  m_height = height;
+  m_sums.assign(size_t(width) * height * 4, 0.0f);
+  m_tile_rows.assign(m_threads * 2, 0);
+  m_thread_cols.assign(m_threads * 2, 0);
+  m_binned = 0;
+}
+
+void DensityBinner::set_palette(const VertexColour* palette, int count) {
+  /* Copied member by member, the packed colours may not be float aligned */
+  m_palette.resize(size_t(count) * 4);
+  for (int i = 0; i < count; ++i) {
+    const VertexColour c = palette[i];
+    m_palette[i*4 + 0] = c.r;
+    m_palette[i*4 + 1] = c.g;
+    m_palette[i*4 + 2] = c.b;
+    m_palette[i*4 + 3] = c.a;
+  }
+}
+
+void DensityBinner::sort_points(int thread, const VertexPos* pos, size_t count,
+                                const glm::vec4& quant, const glm::vec4& view) {
+  std::vector<std::vector<BinnedPoint>>& tiles = m_tiles[thread];
+  for (std::vector<BinnedPoint>& tile : tiles) {
+    tile.clear();
+  }
+  const size_t colours = m_palette.size() / 4;
+  const size_t begin = count * thread / m_threads;
+  const size_t end = count * (thread + 1) / m_threads;
+
+  /* Fold quantized -> world -> clip -> pixel into one scale and offset */
+  const float sx = view.x / quant.z * 0.5f * m_width;
+  const float sy = view.y / quant.w * 0.5f * m_height;
+  const float ox = ((quant.x * view.x + view.z) * 0.5f + 0.5f) * m_width;
+  const float oy = ((quant.y * view.y + view.w) * 0.5f + 0.5f) * m_height;
+
+  int tile = 0;
+  int min_col = m_width;
+  int max_col = 0;
+  for (size_t i = begin; i < end; ++i) {
+    const GLshort qx = pos[i].x;
+    const GLshort qy = pos[i].y;
+    if (qx == hidden_vertex) continue;
+    const float px = float(qx) * sx + ox;
+    const float py = float(qy) * sy + oy;
+    if (!(px >= 0.0f && py >= 0.0f && px < float(m_width) && py < float(m_height))) continue;
+    const int row = int(py);
+    const int col = int(px);
+    /* Consecutive points are usually close, so start from the last tile */
+    while (row < tile_start(tile)) tile -= 1;
+    while (row >= tile_start(tile + 1)) tile += 1;
+    tiles[tile].push_back(BinnedPoint{uint32_t(row) * uint32_t(m_width) + uint32_t(col), uint32_t(i % colours)});
+    min_col = std::min(min_col, col);
+    max_col = std::max(max_col, col + 1);
+  }
+  m_thread_cols[thread*2 + 0] = min_col;
+  m_thread_cols[thread*2 + 1] = max_col;
+}
+
+void DensityBinner::merge_tile(int tile) {
+  /* Clear what the last frame left in this tile */
+  int& min_row = m_tile_rows[tile*2 + 0];
+  int& max_row = m_tile_rows[tile*2 + 1];
+  if (max_row > min_row) {
+    std::fill(m_sums.begin() + size_t(min_row) * m_width * 4, m_sums.begin() + size_t(max_row) * m_width * 4, 0.0f);
+  }
+
+  uint32_t min_pixel = UINT32_MAX;
+  uint32_t max_pixel = 0;
+  for (int thread = 0; thread < m_threads; ++thread) {
+    for (const BinnedPoint& pt : m_tiles[thread][tile]) {
+      const float* c = &m_palette[pt.colour * 4];
+      float* sum = &m_sums[size_t(pt.pixel) * 4];
+      sum[0] += c[0] * c[3];
+      sum[1] += c[1] * c[3];
+      sum[2] += c[2] * c[3];
+      sum[3] += c[3];
+      min_pixel = std::min(min_pixel, pt.pixel);
+      max_pixel = std::max(max_pixel, pt.pixel);
+    }
+  }
+  if (min_pixel <= max_pixel) {
+    min_row = int(min_pixel / uint32_t(m_width));
+    max_row = int(max_pixel / uint32_t(m_width)) + 1;
+  } else {
+    min_row = max_row = 0;
+  }
+}
+
+void DensityBinner::bin(const VertexPos* pos, size_t count, const glm::vec4& quant, const glm::vec4& view) {
+  if (m_palette.empty() || m_width <= 0 || m_height <= 0) {
+    m_binned = 0;
+    return;
+  }
+
+  m_pool.run(m_threads, [&](int thread) { sort_points(thread, pos, count, quant, view); });
+  m_pool.run(m_threads, [&](int tile) { merge_tile(tile); });
+
+  m_binned = 0;
+  for (int thread = 0; thread < m_threads; ++thread) {
+    for (int tile = 0; tile < m_threads; ++tile) {
+      m_binned += m_tiles[thread][tile].size();
+    }
+  }
+}
+
+int DensityBinner::min_row() const {
+  int row = m_height;
+  for (int tile = 0; tile < m_threads; ++tile) {
+    if (m_tile_rows[tile*2 + 1] > m_tile_rows[tile*2]) {
+      row = std::min(row, m_tile_rows[tile*2]);
+    }
+  }
+  return row;
+}
+
+int DensityBinner::max_row() const {
+  int row = 0;
+  for (int tile = 0; tile < m_threads; ++tile) {
+    row = std::max(row, m_tile_rows[tile*2 + 1]);
+  }
+  return row;
+}
+
+int DensityBinner::min_col() const {
+  int col = m_width;
+  for (int thread = 0; thread < m_threads; ++thread) {
+    col = std::min(col, m_thread_cols[thread*2]);
+  }
+  return col;
+}
+
+int DensityBinner::max_col() const {
+  int col = 0;
+  for (int thread = 0; thread < m_threads; ++thread) {
+    col = std::max(col, m_thread_cols[thread*2 + 1]);
+  }
+  return col;
+}
+
+bool DensityBinner::upload() {
+  gl_state.bind_texture(GL_TEXTURE_2D, m_texture);
+  if (m_texture_size[0] != m_width || m_texture_size[1] != m_height) {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, m_width, m_height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+    m_texture_size[0] = m_width;
+    m_texture_size[1] = m_height;
+  }
+  m_upload_bytes = 0;
+  const int lo = min_row();
+  const int hi = max_row();
+  const int left = min_col();
+  const int right = max_col();
+  if (m_binned == 0 || hi <= lo || right <= left) {
+    return false;
+  }
+
+  /* Only the touched rectangle (the composite is scissored to it), packed to half floats */
+  const size_t rect_w = size_t(right - left);
+  const int rows = hi - lo;
+  m_upload.resize(rect_w * rows * 4);
+  m_pool.run(m_threads, [&](int part) {
+    for (int row = lo + rows * part / m_threads; row < lo + rows * (part + 1) / m_threads; ++row) {
+      const float* src = &m_sums[(size_t(row) * m_width + left) * 4];
+      uint16_t* dst = &m_upload[size_t(row - lo) * rect_w * 4];
+      for (size_t i = 0; i < rect_w * 4; ++i) {
+        dst[i] = FloatToHalf(src[i]);
+      }
+    }
+  });
+  glTexSubImage2D(GL_TEXTURE_2D, 0, left, lo, GLsizei(rect_w), rows, GL_RGBA, GL_HALF_FLOAT, m_upload.data());
+  m_upload_bytes = m_upload.size() * sizeof(uint16_t);
+  return true;
+}
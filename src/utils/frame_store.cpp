@@ -0,0 +1,219 @@
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "frame_store.h"
+
+static const double quant_scale = 32767.0 / FRAME_RANGE;
+
+static inline void put_varint(std::vector<uint8_t>& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(uint8_t(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(uint8_t(value));
+}
+
+static inline uint32_t get_varint(uint8_t const *& in) {
+  uint32_t value = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = *in++;
+    value |= uint32_t(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return value;
+}
+
+static inline uint32_t zigzag(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+static inline int32_t unzigzag(uint32_t v) { return int32_t(v >> 1) ^ -int32_t(v & 1); }
+
+static const int16_t hidden_point = INT16_MIN;
+static const size_t max_pending_frames = 3;
+
+static void EncodeFrame(std::vector<int16_t> const & raw, int iters, std::vector<uint8_t>& out) {
+  std::vector<int32_t> prev(iters * 2, 0);
+  uint32_t hidden_run = 0;
+  out.clear();
+  out.reserve(raw.size() * 2);
+  for (size_t i = 0; i < raw.size() / 2; ++i) {
+    const int32_t qx = raw[i*2 + 0];
+    const int32_t qy = raw[i*2 + 1];
+    if (qx == hidden_point) {
+      hidden_run += 1;
+      continue;
+    }
+    if (hidden_run > 0) {
+      /* A zero tag starts a run of hidden points */
+      put_varint(out, 0);
+      put_varint(out, hidden_run - 1);
+      hidden_run = 0;
+    }
+    const int iter = int(i % iters);
+    put_varint(out, (zigzag(qx - prev[iter*2 + 0]) << 1) | 1);
+    put_varint(out, zigzag(qy - prev[iter*2 + 1]));
+    prev[iter*2 + 0] = qx;
+    prev[iter*2 + 1] = qy;
+  }
+  if (hidden_run > 0) {
+    put_varint(out, 0);
+    put_varint(out, hidden_run - 1);
+  }
+  out.shrink_to_fit();
+}
+
+FrameEncoder::FrameEncoder(int iters)
+  : m_iters(iters), m_pending(0), m_generation(0), m_stop(false) {
+  m_thread = std::thread(&FrameEncoder::work, this);
+}
+
+FrameEncoder::~FrameEncoder() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_one();
+  m_thread.join();
+}
+
+void FrameEncoder::begin() {
+  m_raw.clear();
+}
+
+void FrameEncoder::push(double x, double y) {
+  if (!(std::fabs(x) <= FRAME_RANGE && std::fabs(y) <= FRAME_RANGE)) {
+    m_raw.push_back(hidden_point);
+    m_raw.push_back(hidden_point);
+    return;
+  }
+  m_raw.push_back(int16_t(std::lround(x * quant_scale)));
+  m_raw.push_back(int16_t(std::lround(y * quant_scale)));
+}
+
+void FrameEncoder::submit(double t, double rolling_delta, std::vector<glm::vec2> const & history, bool cache, bool ring) {
+  Job job;
+  job.out.frame.t = t;
+  job.out.frame.rolling_delta = rolling_delta;
+  job.out.history = history;
+  job.out.cache = cache;
+  job.out.ring = ring;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_finished.wait(lock, [this]() { return m_pending < max_pending_frames; });
+    job.raw.swap(m_raw);
+    if (!m_spare.empty()) {
+      m_raw.swap(m_spare.back());
+      m_spare.pop_back();
+    }
+    m_queue.push_back(std::move(job));
+    m_pending += 1;
+  }
+  m_wake.notify_one();
+}
+
+bool FrameEncoder::collect(EncodedFrame& frame, bool wait) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (wait) {
+    m_finished.wait(lock, [this]() { return m_pending == 0 || !m_done.empty(); });
+  }
+  if (m_done.empty()) {
+    return false;
+  }
+  frame = std::move(m_done.front());
+  m_done.pop_front();
+  return true;
+}
+
+void FrameEncoder::discard() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (Job& job : m_queue) {
+    m_spare.push_back(std::move(job.raw));
+  }
+  m_pending -= m_queue.size();
+  m_queue.clear();
+  m_done.clear();
+  //A frame being encoded now is dropped when it finishes
+  m_generation += 1;
+  m_finished.notify_all();
+}
+
+void FrameEncoder::work() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_wake.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+    if (m_stop) {
+      return;
+    }
+    Job job = std::move(m_queue.front());
+    m_queue.pop_front();
+    const unsigned int generation = m_generation;
+    lock.unlock();
+    EncodeFrame(job.raw, m_iters, job.out.frame.data);
+    lock.lock();
+    if (generation == m_generation) {
+      m_done.push_back(std::move(job.out));
+    }
+    m_pending -= 1;
+    m_spare.push_back(std::move(job.raw));
+    m_finished.notify_all();
+  }
+}
+
+void UnpackFrame(PackedFrame const & frame, int iters, std::vector<glm::vec2>& points) {
+  static const float hidden = std::numeric_limits<float>::quiet_NaN();
+  std::vector<int32_t> prev(iters * 2, 0);
+  uint8_t const * in = frame.data.data();
+  uint8_t const * end = in + frame.data.size();
+  size_t i = 0;
+  while (in < end && i < points.size()) {
+    const uint32_t tag = get_varint(in);
+    if (tag == 0) {
+      size_t run = size_t(get_varint(in)) + 1;
+      for (; run > 0 && i < points.size(); --run, ++i) {
+        points[i] = glm::vec2(hidden, hidden);
+      }
+      continue;
+    }
+    const int iter = int(i % iters);
+    prev[iter*2 + 0] += unzigzag(tag >> 1);
+    prev[iter*2 + 1] += unzigzag(get_varint(in));
+    points[i] = glm::vec2(float(prev[iter*2 + 0] / quant_scale), float(prev[iter*2 + 1] / quant_scale));
+    ++i;
+  }
+  for (; i < points.size(); ++i) {
+    points[i] = glm::vec2(hidden, hidden);
+  }
+}
+
+void SweepCache::clear() {
+  m_frames.clear();
+  m_resume_history.clear();
+  m_bytes = 0;
+  m_complete = false;
+}
+
+bool SweepCache::add(PackedFrame&& frame, std::vector<glm::vec2> const & history) {
+  const size_t frame_bytes = frame.data.size() + sizeof(PackedFrame);
+  if (m_bytes + frame_bytes > m_budget) {
+    return false;
+  }
+  m_bytes += frame_bytes;
+  m_frames.push_back(std::move(frame));
+  m_resume_history = history;
+  return true;
+}
+
+size_t SweepCache::seek(double t) const {
+  auto it = std::lower_bound(m_frames.begin(), m_frames.end(), t,
+    [](PackedFrame const & frame, double t) { return frame.t < t; });
+  return size_t(it - m_frames.begin());
+}
+
+void FrameRing::push(PackedFrame&& frame) {
+  m_bytes += frame.data.size() + sizeof(PackedFrame);
+  m_frames.push_back(std::move(frame));
+  while (m_frames.size() > 1 && m_bytes > m_budget) {
+    m_bytes -= m_frames.front().data.size() + sizeof(PackedFrame);
+    m_frames.pop_front();
+  }
+}
@@ -0,0 +1,46 @@
+#include <cstring>
+#include "gl_ext.h"
+
+GLExtensions gl_ext = {};
+
+bool HasGLExtension(char const * name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; ++i) {
+    char const * ext = reinterpret_cast<char const *>(glGetStringi(GL_EXTENSIONS, i));
+    if (ext && std::strcmp(ext, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool has_version(int major, int minor) {
+  GLint context_major = 0, context_minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+  glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+  return context_major > major || (context_major == major && context_minor >= minor);
+}
+
+void LoadGLExtensions(GLADloadproc load) {
+  gl_ext = {};
+
+  if (has_version(4, 4) || HasGLExtension("GL_ARB_buffer_storage")) {
+    gl_ext.BufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(load("glBufferStorage"));
+    gl_ext.buffer_storage = gl_ext.BufferStorage != nullptr;
+  }
+
+  if (has_version(4, 1) || HasGLExtension("GL_ARB_get_program_binary")) {
+    gl_ext.GetProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYPROC>(load("glGetProgramBinary"));
+    gl_ext.ProgramBinary = reinterpret_cast<PFNGLPROGRAMBINARYPROC>(load("glProgramBinary"));
+    gl_ext.ProgramParameteri = reinterpret_cast<PFNGLPROGRAMPARAMETERIPROC>(load("glProgramParameteri"));
+    gl_ext.program_binary = gl_ext.GetProgramBinary && gl_ext.ProgramBinary && gl_ext.ProgramParameteri;
+  }
+
+  if (HasGLExtension("GL_KHR_parallel_shader_compile")) {
+    gl_ext.MaxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(load("glMaxShaderCompilerThreadsKHR"));
+  } else if (HasGLExtension("GL_ARB_parallel_shader_compile")) {
+    gl_ext.MaxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(load("glMaxShaderCompilerThreadsARB"));
+  }
+  gl_ext.parallel_shader_compile = gl_ext.MaxShaderCompilerThreads != nullptr;
+}
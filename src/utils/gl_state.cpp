@@ -0,0 +1,181 @@
+#include "gl_state.h"
+
+GLStateCache gl_state;
+
+static const GLenum tracked_caps[] = {
+  GL_BLEND, GL_SCISSOR_TEST, GL_CULL_FACE, GL_DEPTH_TEST, GL_STENCIL_TEST,
+  GL_PRIMITIVE_RESTART, GL_PROGRAM_POINT_SIZE,
+  GL_CLIP_DISTANCE0, GL_CLIP_DISTANCE0 + 1, GL_CLIP_DISTANCE0 + 2, GL_CLIP_DISTANCE0 + 3
+};
+
+static int cap_index(GLenum cap) {
+  for (int i = 0; i < int(sizeof(tracked_caps) / sizeof(tracked_caps[0])); ++i) {
+    if (tracked_caps[i] == cap) return i;
+  }
+  return -1;
+}
+
+GLStateCache::GLStateCache()
+  : m_program(0), m_vertex_array(0), m_array_buffer(0), m_active_texture(GL_TEXTURE0),
+    m_textures{}, m_samplers{}, m_draw_framebuffer(0), m_read_framebuffer(0), m_caps{},
+    m_blend_func{GL_ONE, GL_ZERO, GL_ONE, GL_ZERO}, m_blend_equation{GL_FUNC_ADD, GL_FUNC_ADD},
+    m_viewport{}, m_scissor{}, m_polygon_mode(GL_FILL), m_counters{} {
+  static_assert(sizeof(tracked_caps) / sizeof(tracked_caps[0]) == num_caps, "Tracked caps don't match");
+}
+
+void GLStateCache::sync() {
+  GLint value;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &value); m_program = GLuint(value);
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value); m_vertex_array = GLuint(value);
+  glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &value); m_array_buffer = GLuint(value);
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &value); m_active_texture = GLenum(value);
+  for (int unit = 0; unit < num_units; ++unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &value); m_textures[unit] = GLuint(value);
+    glGetIntegerv(GL_SAMPLER_BINDING, &value); m_samplers[unit] = GLuint(value);
+  }
+  glActiveTexture(m_active_texture);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &value); m_draw_framebuffer = GLuint(value);
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &value); m_read_framebuffer = GLuint(value);
+  for (int i = 0; i < num_caps; ++i) {
+    m_caps[i] = glIsEnabled(tracked_caps[i]) == GL_TRUE;
+  }
+  const GLenum blend_func_names[4] = {GL_BLEND_SRC_RGB, GL_BLEND_DST_RGB, GL_BLEND_SRC_ALPHA, GL_BLEND_DST_ALPHA};
+  for (int i = 0; i < 4; ++i) {
+    glGetIntegerv(blend_func_names[i], &value); m_blend_func[i] = GLenum(value);
+  }
+  glGetIntegerv(GL_BLEND_EQUATION_RGB, &value); m_blend_equation[0] = GLenum(value);
+  glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &value); m_blend_equation[1] = GLenum(value);
+  glGetIntegerv(GL_VIEWPORT, m_viewport);
+  glGetIntegerv(GL_SCISSOR_BOX, m_scissor);
+  GLint polygon_mode[2];
+  glGetIntegerv(GL_POLYGON_MODE, polygon_mode);
+  m_polygon_mode = GLenum(polygon_mode[0]);
+}
+
+void GLStateCache::use_program(GLuint program) {
+  if (changed(m_program != program)) {
+    m_program = program;
+    glUseProgram(program);
+  }
+}
+
+void GLStateCache::bind_vertex_array(GLuint vertex_array) {
+  if (changed(m_vertex_array != vertex_array)) {
+    m_vertex_array = vertex_array;
+    glBindVertexArray(vertex_array);
+  }
+}
+
+void GLStateCache::bind_buffer(GLenum target, GLuint buffer) {
+  /* Only the array buffer, the element buffer belongs to the vertex array */
+  if (target != GL_ARRAY_BUFFER) {
+    changed(true);
+    glBindBuffer(target, buffer);
+  } else if (changed(m_array_buffer != buffer)) {
+    m_array_buffer = buffer;
+    glBindBuffer(target, buffer);
+  }
+}
+
+void GLStateCache::active_texture(GLenum unit) {
+  if (changed(m_active_texture != unit)) {
+    m_active_texture = unit;
+    glActiveTexture(unit);
+  }
+}
+
+void GLStateCache::bind_texture(GLenum target, GLuint texture) {
+  GLuint& bound = m_textures[m_active_texture - GL_TEXTURE0];
+  if (target != GL_TEXTURE_2D) {
+    changed(true);
+    glBindTexture(target, texture);
+  } else if (changed(bound != texture)) {
+    bound = texture;
+    glBindTexture(target, texture);
+  }
+}
+
+void GLStateCache::bind_sampler(GLuint unit, GLuint sampler) {
+  if (changed(m_samplers[unit] != sampler)) {
+    m_samplers[unit] = sampler;
+    glBindSampler(unit, sampler);
+  }
+}
+
+void GLStateCache::bind_framebuffer(GLenum target, GLuint framebuffer) {
+  const bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+  const bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+  if (changed((draw && m_draw_framebuffer != framebuffer) || (read && m_read_framebuffer != framebuffer))) {
+    if (draw) m_draw_framebuffer = framebuffer;
+    if (read) m_read_framebuffer = framebuffer;
+    glBindFramebuffer(target, framebuffer);
+  }
+}
+
+void GLStateCache::set_enabled(GLenum cap, bool enabled) {
+  const int i = cap_index(cap);
+  if (i < 0 || changed(m_caps[i] != enabled)) {
+    if (i >= 0) {
+      m_caps[i] = enabled;
+    } else {
+      changed(true);
+    }
+    if (enabled) glEnable(cap); else glDisable(cap);
+  }
+}
+
+bool GLStateCache::is_enabled(GLenum cap) {
+  const int i = cap_index(cap);
+  if (i < 0) {
+    return glIsEnabled(cap) == GL_TRUE;
+  }
+  m_counters.queries += 1;
+  return m_caps[i];
+}
+
+void GLStateCache::blend_func_separate(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha) {
+  if (changed(m_blend_func[0] != src_rgb || m_blend_func[1] != dst_rgb ||
+              m_blend_func[2] != src_alpha || m_blend_func[3] != dst_alpha)) {
+    m_blend_func[0] = src_rgb;
+    m_blend_func[1] = dst_rgb;
+    m_blend_func[2] = src_alpha;
+    m_blend_func[3] = dst_alpha;
+    glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+  }
+}
+
+void GLStateCache::blend_equation_separate(GLenum mode_rgb, GLenum mode_alpha) {
+  if (changed(m_blend_equation[0] != mode_rgb || m_blend_equation[1] != mode_alpha)) {
+    m_blend_equation[0] = mode_rgb;
+    m_blend_equation[1] = mode_alpha;
+    glBlendEquationSeparate(mode_rgb, mode_alpha);
+  }
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  if (changed(m_viewport[0] != x || m_viewport[1] != y || m_viewport[2] != width || m_viewport[3] != height)) {
+    m_viewport[0] = x;
+    m_viewport[1] = y;
+    m_viewport[2] = width;
+    m_viewport[3] = height;
+    glViewport(x, y, width, height);
+  }
+}
+
+void GLStateCache::scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+  if (changed(m_scissor[0] != x || m_scissor[1] != y || m_scissor[2] != width || m_scissor[3] != height)) {
+    m_scissor[0] = x;
+    m_scissor[1] = y;
+    m_scissor[2] = width;
+    m_scissor[3] = height;
+    glScissor(x, y, width, height);
+  }
+}
+
+void GLStateCache::polygon_mode(GLenum mode) {
+  if (changed(m_polygon_mode != mode)) {
+    m_polygon_mode = mode;
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+  }
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include "gpu_profiler.h"
+
+GpuProfiler::GpuProfiler(size_t history)
+  : m_history(history), m_enabled(false), m_active(-1), m_slot(0), m_frame(0), m_slot_frames{},
+    m_collected_ms(0.0), m_collected(false) {}
+
+GpuProfiler::~GpuProfiler() {
+  if (m_active >= 0) {
+    glEndQuery(GL_TIME_ELAPSED);
+  }
+  for (Pass& pass : m_passes) {
+    glDeleteQueries(num_frames, pass.queries);
+  }
+}
+
+bool GpuProfiler::open_csv(const std::string& path) {
+  m_csv.open(path, std::ios::trunc);
+  if (!m_csv) {
+    return false;
+  }
+  m_csv << "frame,pass,ms\n";
+  return true;
+}
+
+void GpuProfiler::begin(const char* name) {
+  if (!m_enabled || m_active >= 0) {
+    return;
+  }
+  size_t i = 0;
+  while (i < m_passes.size() && m_passes[i].name != name) {
+    ++i;
+  }
+  if (i == m_passes.size()) {
+    Pass pass{name, {}, {}, {}, 0};
+    glGenQueries(num_frames, pass.queries);
+    m_passes.push_back(std::move(pass));
+  }
+  Pass& pass = m_passes[i];
+  glBeginQuery(GL_TIME_ELAPSED, pass.queries[m_slot]);
+  pass.pending[m_slot] = true;
+  m_active = int(i);
+}
+
+void GpuProfiler::end() {
+  if (m_active < 0) {
+    return;
+  }
+  glEndQuery(GL_TIME_ELAPSED);
+  m_active = -1;
+}
+
+bool GpuProfiler::collect(Pass& pass, int slot) {
+  if (!pass.pending[slot]) {
+    return false;
+  }
+  /* Still in flight after num_frames frames, drop it rather than wait */
+  pass.pending[slot] = false;
+  GLint available = 0;
+  glGetQueryObjectiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    return false;
+  }
+  GLuint64 ns = 0;
+  glGetQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT, &ns);
+  const double ms = double(ns) * 1e-6;
+
+  if (pass.history.size() < m_history) {
+    pass.history.push_back(ms);
+  } else {
+    pass.history[pass.next] = ms;
+  }
+  pass.next = (pass.next + 1) % m_history;
+  if (m_csv.is_open()) {
+    m_csv << m_slot_frames[slot] << "," << pass.name << "," << ms << "\n";
+  }
+  m_collected_ms += ms;
+  return true;
+}
+
+void GpuProfiler::next_frame() {
+  end();
+  m_frame += 1;
+  m_slot = (m_slot + 1) % num_frames;
+  /* The oldest frame's queries are about to be reused */
+  m_collected_ms = 0.0;
+  m_collected = false;
+  for (Pass& pass : m_passes) {
+    m_collected |= collect(pass, m_slot);
+  }
+  m_slot_frames[m_slot] = m_frame;
+}
+
+std::vector<GpuPassStats> GpuProfiler::stats() const {
+  std::vector<GpuPassStats> result;
+  for (const Pass& pass : m_passes) {
+    GpuPassStats stats{pass.name, pass.history.size(), 0.0, 0.0, 0.0, 0.0};
+    if (!pass.history.empty()) {
+      std::vector<double> sorted = pass.history;
+      std::sort(sorted.begin(), sorted.end());
+      for (double ms : sorted) {
+        stats.average += ms;
+      }
+      stats.average /= double(sorted.size());
+      auto percentile = [&](double q) { return sorted[std::min(sorted.size() - 1, size_t(q * sorted.size()))]; };
+      stats.p50 = percentile(0.50);
+      stats.p95 = percentile(0.95);
+      stats.p99 = percentile(0.99);
+    }
+    result.push_back(stats);
+  }
+  return result;
+}
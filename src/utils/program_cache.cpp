@@ -0,0 +1,168 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+#include "program_cache.h"
+#include "gl_ext.h"
+
+ProgramCache program_cache;
+
+static const char program_cache_magic[4] = { 'P', 'B', 'N', '1' };
+
+template <typename T>
+static void write_pod(std::ofstream& out, T const & value) {
+  out.write(reinterpret_cast<char const *>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool read_pod(std::ifstream& in, T& value) {
+  return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+/* FNV-1a, chained through seed */
+static const uint64_t hash_offset = 0xcbf29ce484222325ull;
+
+static uint64_t hash_bytes(void const * data, size_t size, uint64_t seed = hash_offset) {
+  unsigned char const * bytes = static_cast<unsigned char const *>(data);
+  uint64_t hash = seed;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static uint64_t hash_string(std::string const & str, uint64_t seed) {
+  /* The length goes in too, so concatenations can't collide */
+  uint64_t size = str.size();
+  return hash_bytes(str.data(), str.size(), hash_bytes(&size, sizeof(size), seed));
+}
+
+static std::string gl_string(GLenum name) {
+  char const * str = reinterpret_cast<char const *>(glGetString(name));
+  return str ? str : "";
+}
+
+void ProgramCache::open(std::string const & dir) {
+  m_dir = dir;
+  m_enabled = false;
+  if (!gl_ext.program_binary) {
+    return;
+  }
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  if (formats <= 0) {
+    return;
+  }
+  std::error_code error;
+  std::filesystem::create_directories(m_dir, error);
+  m_driver = gl_string(GL_VENDOR) + "|" + gl_string(GL_RENDERER) + "|" + gl_string(GL_VERSION);
+  m_enabled = true;
+}
+
+std::string ProgramCache::path(uint64_t key) const {
+  std::ostringstream name;
+  name << m_dir << '/' << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+  return name.str();
+}
+
+uint64_t ProgramCache::key(std::initializer_list<uint64_t> source_hashes, std::string const & config) const {
+  uint64_t hash = hash_string(m_driver, hash_string(config, hash_offset));
+  for (uint64_t source : source_hashes) {
+    hash = hash_bytes(&source, sizeof(source), hash);
+  }
+  return hash;
+}
+
+void ProgramCache::prepare(GLuint program) const {
+  if (m_enabled) {
+    gl_ext.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+}
+
+bool ProgramCache::load(GLuint program, uint64_t key) {
+  if (!m_enabled) {
+    return false;
+  }
+  std::error_code error;
+  const uintmax_t file_size = std::filesystem::file_size(path(key), error);
+  std::ifstream in(path(key), std::ios::binary);
+  if (error || !in) {
+    m_misses += 1;
+    return false;
+  }
+
+  /* The key is only a hash, the driver string is checked in full */
+  char magic[4];
+  uint64_t file_key, checksum;
+  uint32_t driver_size, format, size;
+  std::string driver;
+  std::vector<char> binary;
+  bool valid = in.read(magic, sizeof(magic)) && std::equal(magic, magic + 4, program_cache_magic)
+    && read_pod(in, file_key) && file_key == key && read_pod(in, driver_size) && driver_size == m_driver.size();
+  if (valid) {
+    driver.resize(driver_size);
+    valid = in.read(&driver[0], driver_size) && driver == m_driver
+      && read_pod(in, format) && read_pod(in, size) && read_pod(in, checksum);
+  }
+  /* The blob runs to the end of the file, a bad size must not pick the allocation */
+  valid = valid && uintmax_t(size) == file_size - uintmax_t(in.tellg());
+  if (valid) {
+    binary.resize(size);
+    valid = in.read(binary.data(), size) && hash_bytes(binary.data(), size) == checksum;
+  }
+
+  GLint linked = GL_FALSE;
+  if (valid) {
+    gl_ext.ProgramBinary(program, format, binary.data(), GLsizei(size));
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  }
+  if (!linked) {
+    std::cerr << "Ignoring stale program binary: " << path(key) << '\n';
+    m_misses += 1;
+    return false;
+  }
+  m_hits += 1;
+  return true;
+}
+
+void ProgramCache::store(GLuint program, uint64_t key) const {
+  if (!m_enabled) {
+    return;
+  }
+  GLint size = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+  if (size <= 0) {
+    return;
+  }
+  std::vector<char> binary(size);
+  GLenum format = 0;
+  GLsizei length = 0;
+  gl_ext.GetProgramBinary(program, size, &length, &format, binary.data());
+  if (length <= 0) {
+    return;
+  }
+
+  /* Written aside and renamed, so a crash never leaves half a file behind */
+  const std::string file = path(key);
+  const std::string temp = file + ".tmp";
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      std::cerr << "Could not write program binary: " << file << '\n';
+      return;
+    }
+    out.write(program_cache_magic, sizeof(program_cache_magic));
+    write_pod(out, key);
+    write_pod(out, uint32_t(m_driver.size()));
+    out.write(m_driver.data(), m_driver.size());
+    write_pod(out, uint32_t(format));
+    write_pod(out, uint32_t(length));
+    write_pod(out, hash_bytes(binary.data(), size_t(length)));
+    out.write(binary.data(), length);
+  }
+  std::error_code error;
+  std::filesystem::rename(temp, file, error);
+}
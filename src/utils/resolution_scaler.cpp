@@ -0,0 +1,42 @@
+#include "resolution_scaler.h"
+
+static const float scale_levels[] = { 0.5f, 0.625f, 0.75f, 0.875f, 1.0f, 1.25f, 1.5f, 2.0f };
+static const int num_levels = sizeof(scale_levels) / sizeof(scale_levels[0]);
+static const int unit_level = 4;
+static const int window_frames = 30;
+static const double headroom = 0.8;
+
+ResolutionScaler::ResolutionScaler(double budget_ms)
+  : m_budget_ms(budget_ms), m_level(unit_level), m_total_ms(0.0), m_frames(0) {}
+
+float ResolutionScaler::scale() const {
+  return scale_levels[m_level];
+}
+
+bool ResolutionScaler::add_frame(double gpu_ms) {
+  if (!enabled()) {
+    return false;
+  }
+  m_total_ms += gpu_ms;
+  m_frames += 1;
+  if (m_frames < window_frames) {
+    return false;
+  }
+  const double average = m_total_ms / m_frames;
+  m_total_ms = 0.0;
+  m_frames = 0;
+
+  /* Fill cost goes with the pixel count, so predict the next level by area */
+  if (average > m_budget_ms && m_level > 0) {
+    m_level -= 1;
+    return true;
+  }
+  if (m_level + 1 < num_levels) {
+    const double ratio = scale_levels[m_level + 1] / scale_levels[m_level];
+    if (average * ratio * ratio < m_budget_ms * headroom) {
+      m_level += 1;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,234 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include "screenshot_capture.h"
+#include "gl_state.h"
+
+/* PNG with stored (uncompressed) deflate blocks, no zlib needed */
+static uint32_t crc32(uint8_t const * data, size_t size, uint32_t crc = 0) {
+  static uint32_t table[256];
+  static bool table_ready = false;
+  if (!table_ready) {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+    table_ready = true;
+  }
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+static void put_u32(std::vector<uint8_t>& out, uint32_t value) {
+  out.push_back(uint8_t(value >> 24));
+  out.push_back(uint8_t(value >> 16));
+  out.push_back(uint8_t(value >> 8));
+  out.push_back(uint8_t(value));
+}
+
+static void write_chunk(std::ofstream& out, char const * type, std::vector<uint8_t> const & data) {
+  std::vector<uint8_t> chunk(type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  std::vector<uint8_t> length;
+  put_u32(length, uint32_t(data.size()));
+  std::vector<uint8_t> crc;
+  put_u32(crc, crc32(chunk.data(), chunk.size()));
+  out.write(reinterpret_cast<char const *>(length.data()), length.size());
+  out.write(reinterpret_cast<char const *>(chunk.data()), chunk.size());
+  out.write(reinterpret_cast<char const *>(crc.data()), crc.size());
+}
+
+/* RGB rows top down (GL gives them bottom up), alpha dropped */
+static bool write_png(std::string const & path, int width, int height, std::vector<uint8_t> const & rgba) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    return false;
+  }
+  static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  out.write(reinterpret_cast<char const *>(signature), sizeof(signature));
+
+  std::vector<uint8_t> header;
+  put_u32(header, uint32_t(width));
+  put_u32(header, uint32_t(height));
+  header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit RGB, no interlace
+  write_chunk(out, "IHDR", header);
+
+  std::vector<uint8_t> raw;
+  raw.reserve(size_t(width * 3 + 1) * height);
+  for (int y = height - 1; y >= 0; --y) {
+    raw.push_back(0); // No filter
+    uint8_t const * row = rgba.data() + size_t(y) * width * 4;
+    for (int x = 0; x < width; ++x) {
+      raw.insert(raw.end(), row + x * 4, row + x * 4 + 3);
+    }
+  }
+
+  /* zlib stream of stored blocks, then adler32 */
+  std::vector<uint8_t> data = { 0x78, 0x01 };
+  uint32_t a = 1, b = 0;
+  for (size_t pos = 0; pos < raw.size() || pos == 0;) {
+    const size_t size = std::min<size_t>(raw.size() - pos, 65535);
+    const bool last = pos + size == raw.size();
+    data.push_back(last ? 1 : 0);
+    data.push_back(uint8_t(size));
+    data.push_back(uint8_t(size >> 8));
+    data.push_back(uint8_t(~size));
+    data.push_back(uint8_t(~size >> 8));
+    for (size_t i = pos; i < pos + size; ++i) {
+      a = (a + raw[i]) % 65521;
+      b = (b + a) % 65521;
+    }
+    data.insert(data.end(), raw.begin() + pos, raw.begin() + pos + size);
+    pos += size;
+    if (last) {
+      break;
+    }
+  }
+  put_u32(data, (b << 16) | a);
+  write_chunk(out, "IDAT", data);
+  write_chunk(out, "IEND", {});
+  return bool(out);
+}
+
+static std::string timestamp() {
+  const auto now = std::chrono::system_clock::now();
+  const std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+  const int ms = int(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000);
+  std::tm local;
+  localtime_r(&seconds, &local);
+  std::ostringstream out;
+  out << std::put_time(&local, "%Y%m%d-%H%M%S") << '-' << std::setw(3) << std::setfill('0') << ms;
+  return out.str();
+}
+
+ScreenshotCapture::ScreenshotCapture(std::string const & dir) : m_dir(dir), m_slots{}, m_next(0), m_stop(false) {
+  for (Slot& slot : m_slots) {
+    glGenBuffers(1, &slot.pbo);
+  }
+  m_writer = std::thread(&ScreenshotCapture::write_images, this);
+}
+
+ScreenshotCapture::~ScreenshotCapture() {
+  /* Keep what was already captured */
+  for (int i = 0; i < num_pbos; ++i) {
+    read(m_slots[(m_next + i) % num_pbos], true);
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_one();
+  m_writer.join();
+  for (Slot& slot : m_slots) {
+    glDeleteBuffers(1, &slot.pbo);
+  }
+}
+
+bool ScreenshotCapture::capture(int width, int height, std::string const & tag) {
+  Slot& slot = m_slots[m_next];
+  if (slot.fence || width <= 0 || height <= 0) {
+    return false;
+  }
+  m_next = (m_next + 1) % num_pbos;
+
+  const GLsizeiptr size = GLsizeiptr(width) * height * 4;
+  gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  if (slot.capacity != size) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    slot.capacity = size;
+  }
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.width = width;
+  slot.height = height;
+  slot.path = m_dir + "/" + timestamp() + "_" + tag + ".png";
+  return true;
+}
+
+bool ScreenshotCapture::read(Slot& slot, bool wait) {
+  if (!slot.fence) {
+    return false;
+  }
+  const GLuint64 timeout = wait ? GLuint64(1000000000) : 0;
+  if (glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout) == GL_TIMEOUT_EXPIRED) {
+    return false;
+  }
+  glDeleteSync(slot.fence);
+  slot.fence = nullptr;
+
+  Image image;
+  image.path = slot.path;
+  image.width = slot.width;
+  image.height = slot.height;
+  image.rgba.resize(size_t(slot.width) * slot.height * 4);
+  gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image.rgba.size(), GL_MAP_READ_BIT);
+  if (data) {
+    std::memcpy(image.rgba.data(), data, image.rgba.size());
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+  if (!data) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_images.push_back(std::move(image));
+  }
+  m_wake.notify_one();
+  return true;
+}
+
+void ScreenshotCapture::poll() {
+  /* Oldest first, so files land in capture order */
+  for (int i = 0; i < num_pbos; ++i) {
+    Slot& slot = m_slots[(m_next + i) % num_pbos];
+    if (slot.fence && !read(slot, false)) {
+      break;
+    }
+  }
+}
+
+int ScreenshotCapture::in_flight() const {
+  int count = 0;
+  for (Slot const & slot : m_slots) {
+    count += slot.fence ? 1 : 0;
+  }
+  return count;
+}
+
+void ScreenshotCapture::write_images() {
+  for (;;) {
+    Image image;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [this]() { return m_stop || !m_images.empty(); });
+      if (m_images.empty()) {
+        return;
+      }
+      image = std::move(m_images.front());
+      m_images.pop_front();
+    }
+    std::error_code error;
+    std::filesystem::create_directories(m_dir, error);
+    if (write_png(image.path, image.width, image.height, image.rgba)) {
+      std::cout << "Screenshot: " << image.path << std::endl;
+    } else {
+      std::cout << "Could not write screenshot: " << image.path << std::endl;
+    }
+  }
+}
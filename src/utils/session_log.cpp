@@ -0,0 +1,150 @@
+#include <iostream>
+#include <algorithm>
+#include "session_log.h"
+
+static const char session_magic[4] = { 'C', 'E', 'Q', '2' };
+
+template <typename T>
+static void write_pod(std::ofstream& out, T const & value) {
+  out.write(reinterpret_cast<char const *>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool read_pod(std::ifstream& in, T& value) {
+  return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+bool SessionRecorder::open(std::string const & path, uint32_t seed, int width, int height, size_t sweep_cache_mb) {
+  m_out.open(path, std::ios::binary | std::ios::trunc);
+  if (!m_out) {
+    std::cerr << "Could not open session log for writing: " << path << '\n';
+    return false;
+  }
+  m_out.write(session_magic, sizeof(session_magic));
+  write_pod(m_out, seed);
+  write_pod(m_out, int32_t(width));
+  write_pod(m_out, int32_t(height));
+  write_pod(m_out, uint64_t(sweep_cache_mb));
+  return true;
+}
+
+void SessionRecorder::code(std::string const & code) {
+  m_out.put(char(code.size()));
+  m_out.write(code.data(), code.size());
+}
+
+void SessionRecorder::frame(double speed_mult) {
+  event(SessionEvent::Frame);
+  write_pod(m_out, speed_mult);
+}
+
+void SessionRecorder::key(int key) {
+  event(SessionEvent::Key);
+  write_pod(m_out, int16_t(key));
+}
+
+void SessionRecorder::resize(int width, int height) {
+  event(SessionEvent::Resize);
+  write_pod(m_out, int32_t(width));
+  write_pod(m_out, int32_t(height));
+}
+
+void SessionRecorder::load(std::string const & code) {
+  event(SessionEvent::Load);
+  this->code(code.substr(0, 255));
+}
+
+void SessionRecorder::equation(std::string const & code) {
+  event(SessionEvent::Equation);
+  this->code(code.substr(0, 255));
+}
+
+void SessionRecorder::seek(double t, Checkpoint const * checkpoint) {
+  event(SessionEvent::Seek);
+  write_pod(m_out, t);
+  m_out.put(char(checkpoint != nullptr));
+  if (checkpoint) {
+    write_pod(m_out, checkpoint->t);
+    write_pod(m_out, checkpoint->rolling_delta);
+    write_pod(m_out, checkpoint->plot_scale);
+    write_pod(m_out, checkpoint->plot_x);
+    write_pod(m_out, checkpoint->plot_y);
+    write_pod(m_out, uint32_t(checkpoint->history.size()));
+    m_out.write(reinterpret_cast<char const *>(checkpoint->history.data()),
+                checkpoint->history.size() * sizeof(glm::vec2));
+  }
+}
+
+void SessionRecorder::view(float scale, float x, float y) {
+  event(SessionEvent::View);
+  write_pod(m_out, scale);
+  write_pod(m_out, x);
+  write_pod(m_out, y);
+}
+
+bool SessionPlayer::open(std::string const & path) {
+  m_in.open(path, std::ios::binary);
+  char magic[4];
+  int32_t width, height;
+  uint64_t sweep_cache_mb;
+  if (!m_in || !m_in.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, session_magic)
+      || !read_pod(m_in, m_seed) || !read_pod(m_in, width) || !read_pod(m_in, height)
+      || !read_pod(m_in, sweep_cache_mb)) {
+    std::cerr << "Not a session log: " << path << '\n';
+    m_in.close();
+    return false;
+  }
+  m_width = width;
+  m_height = height;
+  m_sweep_cache_mb = sweep_cache_mb;
+  return true;
+}
+
+bool SessionPlayer::next(SessionRecord& record) {
+  const int type = m_in.get();
+  if (type == std::char_traits<char>::eof()) {
+    return false;
+  }
+  record.type = SessionEvent(type);
+  switch (record.type) {
+  case SessionEvent::Frame:
+    return read_pod(m_in, record.value);
+  case SessionEvent::Seek: {
+    if (!read_pod(m_in, record.value)) return false;
+    const int has_checkpoint = m_in.get();
+    if (has_checkpoint == std::char_traits<char>::eof()) return false;
+    record.has_checkpoint = has_checkpoint != 0;
+    if (!record.has_checkpoint) return true;
+    Checkpoint& cp = record.checkpoint;
+    uint32_t history_size;
+    if (!read_pod(m_in, cp.t) || !read_pod(m_in, cp.rolling_delta) || !read_pod(m_in, cp.plot_scale)
+        || !read_pod(m_in, cp.plot_x) || !read_pod(m_in, cp.plot_y) || !read_pod(m_in, history_size)) return false;
+    cp.history.resize(history_size);
+    return bool(m_in.read(reinterpret_cast<char*>(cp.history.data()), history_size * sizeof(glm::vec2)));
+  }
+  case SessionEvent::Key: {
+    int16_t key;
+    if (!read_pod(m_in, key)) return false;
+    record.key = key;
+    return true;
+  }
+  case SessionEvent::Resize: {
+    int32_t width, height;
+    if (!read_pod(m_in, width) || !read_pod(m_in, height)) return false;
+    record.width = width;
+    record.height = height;
+    return true;
+  }
+  case SessionEvent::View:
+    return read_pod(m_in, record.view[0]) && read_pod(m_in, record.view[1]) && read_pod(m_in, record.view[2]);
+  case SessionEvent::Load:
+  case SessionEvent::Equation: {
+    const int size = m_in.get();
+    if (size == std::char_traits<char>::eof()) return false;
+    record.code.resize(size);
+    return bool(m_in.read(&record.code[0], size));
+  }
+  }
+  std::cerr << "Corrupt session log (event " << type << ")\n";
+  return false;
+}
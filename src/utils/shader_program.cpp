@@ -1,7 +1,10 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cerrno>
+#include <algorithm>
 #include "shader_program.h"
+#include "program_cache.h"
 
 static std::string read_file_contents(char const * path) {
   std::ifstream in(path, std::ios::in /*| std::ios::binary*/);
@@ -15,8 +18,35 @@ static std::string read_file_contents(char const * path) {
   return contents;
 }
 
-static bool compile_shader(GLint shader) {
+/* A shader file, with each #include "<file>" line replaced by include/<file> next to it
+   (the makefile does the same for the embedded shaders) */
+static std::string read_shader_file(std::string const & path) {
+  static const std::string directive = "#include \"";
+  const size_t slash = path.find_last_of('/');
+  const std::string include_dir = (slash == std::string::npos ? std::string() : path.substr(0, slash + 1)) + "include/";
+  std::istringstream in(read_file_contents(path.c_str()));
+  std::string expanded;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, directive.size(), directive) == 0) {
+      const std::string file = line.substr(directive.size(), line.find('"', directive.size()) - directive.size());
+      expanded += read_file_contents((include_dir + file).c_str());
+    } else {
+      expanded += line + '\n';
+    }
+  }
+  return expanded;
+}
+
+static GLuint start_compile(GLenum type, std::string const & source) {
+  char const * code = source.c_str();
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &code, NULL);
   glCompileShader(shader);
+  return shader;
+}
+
+static bool compile_succeeded(GLuint shader) {
   int shader_compile_success;
   glGetShaderiv(shader, GL_COMPILE_STATUS, &shader_compile_success);
   return shader_compile_success;
@@ -29,74 +59,210 @@ static void print_object_errors(GLint obj, decltype(glGetShaderInfoLog) glInfoLo
   exit(1);
 }
 
+static std::string shader_override_dir;
+
+void SetShaderOverrideDir(std::string const & dir) {
+  shader_override_dir = dir;
+}
+
 ShaderProgram::ShaderProgram (
   std::string vertex_shader_path,
   std::string frag_shader_path,
   std::string geom_shader_path
-) : m_program_id(-1) {
+) : m_program_id(-1), m_vertex_shader(0), m_frag_shader(0), m_geom_shader(0),
+    m_cache_key(0), m_pending(false) {
 
   /* Read shader files */
   std::string vertex_shader, frag_shader, geom_shader;
   try {
-    vertex_shader = read_file_contents(vertex_shader_path.c_str());
-    frag_shader = read_file_contents(frag_shader_path.c_str());
+    vertex_shader = read_shader_file(vertex_shader_path);
+    frag_shader = read_shader_file(frag_shader_path);
     if (!geom_shader_path.empty()) {
-      geom_shader = read_file_contents(geom_shader_path.c_str());
+      geom_shader = read_shader_file(geom_shader_path);
     }
   } catch (error_t error) {
     std::cerr << "ERROR::SHADER_PROGRAM::FILES_NOT_READABLE ERRNO(" << error << ")\n";
     exit(1);
   }
-  char const * vertex_code = vertex_shader.c_str();
-  char const * frag_code = frag_shader.c_str();
-  char const * geom_code = geom_shader.c_str();
+  build(vertex_shader, HashShaderSource(vertex_shader), frag_shader, HashShaderSource(frag_shader),
+        geom_shader, HashShaderSource(geom_shader));
+}
 
-  /* Compile vertex shader */
-  GLuint vertex_shader_id;
-  vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex_shader_id, 1, &vertex_code, NULL);
-  if (!compile_shader(vertex_shader_id)) {
-    std::cerr << "/* VERTEX SHADER */" << '\n';
-    print_object_errors(vertex_shader_id, glGetShaderInfoLog);
+/* The embedded text, or the file of the same name in the override directory when there is one */
+static std::string resolve_source(ShaderSource const & source, uint64_t& hash) {
+  if (!shader_override_dir.empty()) {
+    try {
+      std::string text = read_shader_file(shader_override_dir + "/" + source.name);
+      hash = HashShaderSource(text);
+      return text;
+    } catch (error_t) {
+      /* Not overridden */
+    }
   }
+  hash = source.hash;
+  return std::string(source.code);
+}
 
-  /* Compile frag shader */
-  GLuint frag_shader_id;
-  frag_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(frag_shader_id, 1, &frag_code, NULL);
-  if (!compile_shader(frag_shader_id)) {
-    std::cerr << "/* FRAG SHADER */" << '\n';
-    print_object_errors(frag_shader_id, glGetShaderInfoLog);
-  }
+ShaderProgram::ShaderProgram (
+  ShaderSource const & vertex_source,
+  ShaderSource const & frag_source,
+  ShaderSource const * geom_source
+) : m_program_id(-1), m_vertex_shader(0), m_frag_shader(0), m_geom_shader(0),
+    m_cache_key(0), m_pending(false) {
+  uint64_t vertex_hash, frag_hash, geom_hash = HashShaderSource("");
+  std::string vertex_shader = resolve_source(vertex_source, vertex_hash);
+  std::string frag_shader = resolve_source(frag_source, frag_hash);
+  std::string geom_shader = geom_source ? resolve_source(*geom_source, geom_hash) : std::string();
+  build(vertex_shader, vertex_hash, frag_shader, frag_hash, geom_shader, geom_hash);
+}
 
+void ShaderProgram::build(
+  std::string const & vertex_shader, uint64_t vertex_hash,
+  std::string const & frag_shader, uint64_t frag_hash,
+  std::string const & geom_shader, uint64_t geom_hash
+) {
+  /* Reuse the driver's binary from an earlier run when nothing changed */
+  m_program_id = glCreateProgram();
+  const std::string config = geom_shader.empty() ? "vertex,fragment" : "vertex,geometry,fragment";
+  const uint64_t cache_key = program_cache.key({vertex_hash, geom_hash, frag_hash}, config);
+  if (program_cache.load(m_program_id, cache_key)) {
+    reflect();
+    return;
+  }
 
-  GLuint geom_shader_id;
+  /* Only start compiling and linking here. Nothing asks for the results until
+     finish(), so with KHR_parallel_shader_compile every program made before
+     the first finish() builds at the same time */
+  m_cache_key = cache_key;
+  m_vertex_shader = start_compile(GL_VERTEX_SHADER, vertex_shader);
+  m_frag_shader = start_compile(GL_FRAGMENT_SHADER, frag_shader);
   if (!geom_shader.empty()) {
-    geom_shader_id = glCreateShader(GL_GEOMETRY_SHADER);
-    glShaderSource(geom_shader_id, 1, &geom_code, NULL);
-    if (!compile_shader(geom_shader_id)) {
-      std::cerr << "/* GEOM SHADER */" << '\n';
-      print_object_errors(geom_shader_id, glGetShaderInfoLog);
-    }
+    m_geom_shader = start_compile(GL_GEOMETRY_SHADER, geom_shader);
   }
 
-
-  /* Link program */
-  m_program_id = glCreateProgram();
-  glAttachShader(m_program_id, vertex_shader_id);
-  if (!geom_shader.empty()) {
-    glAttachShader(m_program_id, geom_shader_id);
+  glAttachShader(m_program_id, m_vertex_shader);
+  if (m_geom_shader) {
+    glAttachShader(m_program_id, m_geom_shader);
   }
-  glAttachShader(m_program_id, frag_shader_id);
+  glAttachShader(m_program_id, m_frag_shader);
+  program_cache.prepare(m_program_id);
   glLinkProgram(m_program_id);
+  m_pending = true;
+}
+
+void ShaderProgram::finish() {
+  if (!m_pending) {
+    return;
+  }
+  m_pending = false;
+
+  /* Check the stages */
+  if (!compile_succeeded(m_vertex_shader)) {
+    std::cerr << "/* VERTEX SHADER */" << '\n';
+    print_object_errors(m_vertex_shader, glGetShaderInfoLog);
+  }
+  if (!compile_succeeded(m_frag_shader)) {
+    std::cerr << "/* FRAG SHADER */" << '\n';
+    print_object_errors(m_frag_shader, glGetShaderInfoLog);
+  }
+  if (m_geom_shader && !compile_succeeded(m_geom_shader)) {
+    std::cerr << "/* GEOM SHADER */" << '\n';
+    print_object_errors(m_geom_shader, glGetShaderInfoLog);
+  }
+
+  /* Check the link */
   int link_sucess;
   glGetProgramiv(m_program_id, GL_LINK_STATUS, &link_sucess);
   if (!link_sucess) {
     std::cerr << "/* LINKING */" << '\n';
     print_object_errors(m_program_id, glGetProgramInfoLog);
   }
+  program_cache.store(m_program_id, m_cache_key);
 
   /* Delete shaders */
-  glDeleteShader(vertex_shader_id);
-  glDeleteShader(frag_shader_id);
+  for (GLuint shader : {m_vertex_shader, m_frag_shader, m_geom_shader}) {
+    if (shader) {
+      glDetachShader(m_program_id, shader);
+      glDeleteShader(shader);
+    }
+  }
+  m_vertex_shader = m_frag_shader = m_geom_shader = 0;
+
+  reflect();
+}
+
+/* Strips the [0] GL reports for arrays, so they are looked up by their plain name */
+static std::string base_uniform_name(char const * name, GLsizei length) {
+  std::string base(name, length);
+  if (base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0) {
+    base.resize(base.size() - 3);
+  }
+  return base;
+}
+
+void ShaderProgram::reflect() {
+  GLint count = 0, max_length = 0;
+  glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+  std::vector<char> name(std::max(max_length, 1));
+  for (GLuint i = 0; i < GLuint(count); ++i) {
+    /* Block members have no location, they are set through their buffer */
+    GLint block_index = -1;
+    glGetActiveUniformsiv(m_program_id, 1, &i, GL_UNIFORM_BLOCK_INDEX, &block_index);
+    if (block_index != -1) {
+      continue;
+    }
+    GLsizei length = 0;
+    ActiveUniform uniform;
+    glGetActiveUniform(m_program_id, i, GLsizei(name.size()), &length, &uniform.size, &uniform.type, name.data());
+    uniform.location = glGetUniformLocation(m_program_id, name.data());
+    uniform.name = base_uniform_name(name.data(), length);
+    m_uniforms.push_back(uniform);
+  }
+
+  glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+  glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_length);
+  name.resize(std::max(max_length, 1));
+  for (GLuint i = 0; i < GLuint(count); ++i) {
+    GLsizei length = 0;
+    ActiveBlock block;
+    glGetActiveUniformBlockName(m_program_id, i, GLsizei(name.size()), &length, name.data());
+    glGetActiveUniformBlockiv(m_program_id, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.data_size);
+    block.name = std::string(name.data(), length);
+    block.index = i;
+    m_blocks.push_back(block);
+  }
+
+  std::sort(m_uniforms.begin(), m_uniforms.end(),
+    [](ActiveUniform const & a, ActiveUniform const & b) { return a.name < b.name; });
+}
+
+ShaderProgram::ActiveUniform const * ShaderProgram::find_uniform(std::string const & name) const {
+  auto it = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), name,
+    [](ActiveUniform const & uniform, std::string const & key) { return uniform.name < key; });
+  if (it == m_uniforms.end() || it->name != name) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+GLint ShaderProgram::uniform_location(std::string const & key) {
+  finish();
+  ActiveUniform const * active = find_uniform(key);
+  return active ? active->location : -1;
+}
+
+bool ShaderProgram::bind_uniform_block(std::string const & name, GLuint binding, GLint expected_size) {
+  finish();
+  for (ActiveBlock const & block : m_blocks) {
+    if (block.name == name) {
+      if (expected_size > 0 && block.data_size > expected_size) {
+        std::cerr << "SHADER_PROGRAM::UNIFORM_BLOCK_TOO_BIG " << name
+                  << " (" << block.data_size << " > " << expected_size << ")\n";
+      }
+      glUniformBlockBinding(m_program_id, block.index, binding);
+      return true;
+    }
+  }
+  return false;
 }
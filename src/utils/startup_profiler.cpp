@@ -0,0 +1,47 @@
+#include <iomanip>
+#include "startup_profiler.h"
+
+StartupProfiler::StartupProfiler()
+  : m_origin(Clock::now()), m_main_thread(std::this_thread::get_id()), m_first_frame_ms(-1.0) {}
+
+double StartupProfiler::now_ms() const {
+  return std::chrono::duration<double, std::milli>(Clock::now() - m_origin).count();
+}
+
+int StartupProfiler::begin(std::string const & name) {
+  const double start = now_ms();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_phases.push_back({name, start, -1.0, std::this_thread::get_id() != m_main_thread});
+  return int(m_phases.size()) - 1;
+}
+
+void StartupProfiler::end(int phase) {
+  const double end = now_ms();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_phases[phase].end_ms = end;
+}
+
+void StartupProfiler::first_frame() {
+  if (!done()) {
+    m_first_frame_ms = now_ms();
+  }
+}
+
+void StartupProfiler::report(std::ostream& out) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  out << "Startup (ms)            start      time" << std::endl;
+  out << std::fixed << std::setprecision(1);
+  for (Phase const & phase : m_phases) {
+    out << "  " << std::left << std::setw(20) << (phase.worker ? phase.name + " *" : phase.name) << std::right
+        << std::setw(7) << phase.start_ms;
+    if (phase.end_ms >= 0.0) {
+      out << std::setw(10) << phase.end_ms - phase.start_ms;
+    } else {
+      out << std::setw(10) << "-";
+    }
+    out << std::endl;
+  }
+  out << "  first frame         " << std::setw(7) << m_first_frame_ms << std::endl;
+  out << "(* on a worker thread)" << std::endl;
+  out << std::defaultfloat;
+}
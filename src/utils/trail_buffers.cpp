@@ -0,0 +1,81 @@
+#include <stdexcept>
+#include "trail_buffers.h"
+#include "gl_state.h"
+
+TrailBuffers::TrailBuffers(int width, int height)
+  : m_current(0), m_width(0), m_height(0), m_hdr(false) {
+  glGenFramebuffers(2, m_framebuffers);
+  glGenTextures(2, m_textures);
+  for (int i = 0; i < 2; ++i) {
+    gl_state.bind_texture(GL_TEXTURE_2D, m_textures[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, m_framebuffers[i]);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_textures[i], 0);
+    GLenum draw_buffers[1] = {GL_COLOR_ATTACHMENT0};
+    glDrawBuffers(1, draw_buffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      throw std::runtime_error("Trail framebuffer is incomplete!");
+    }
+  }
+  resize(width, height);
+}
+
+TrailBuffers::~TrailBuffers() {
+  glDeleteFramebuffers(2, m_framebuffers);
+  glDeleteTextures(2, m_textures);
+}
+
+void TrailBuffers::resize(int width, int height) {
+  m_width = width;
+  m_height = height;
+  const GLint internal_format = m_hdr ? GL_RGBA32F : GL_RGBA;
+  for (int i = 0; i < 2; ++i) {
+    gl_state.bind_texture(GL_TEXTURE_2D, m_textures[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, GL_RGBA, GL_FLOAT, 0);
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, m_framebuffers[i]);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+  }
+  gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void TrailBuffers::rescale(int width, int height) {
+  const GLint internal_format = m_hdr ? GL_RGBA32F : GL_RGBA;
+  GLuint scratch;
+  glGenFramebuffers(1, &scratch);
+  for (int i = 0; i < 2; ++i) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    gl_state.bind_texture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, GL_RGBA, GL_FLOAT, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    /* Filter the old image into the new texture, then swap it in. HDR alpha holds
+       last-write times, which must not be interpolated, so those are sampled */
+    gl_state.bind_framebuffer(GL_DRAW_FRAMEBUFFER, scratch);
+    glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+    gl_state.bind_framebuffer(GL_READ_FRAMEBUFFER, m_framebuffers[i]);
+    glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, width, height, GL_COLOR_BUFFER_BIT,
+                      m_hdr ? GL_NEAREST : GL_LINEAR);
+
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, m_framebuffers[i]);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+    glDeleteTextures(1, &m_textures[i]);
+    m_textures[i] = texture;
+  }
+  gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(1, &scratch);
+  m_width = width;
+  m_height = height;
+}
+
+void TrailBuffers::set_hdr(bool hdr) {
+  if (hdr != m_hdr) {
+    m_hdr = hdr;
+    resize(m_width, m_height);
+  }
+}
@@ -0,0 +1,69 @@
+#include "gl_ext.h"
+#include "vertex_stream.h"
+#include "gl_state.h"
+
+VertexStream::VertexStream(GLsizeiptr vertex_size, GLsizei vertex_count, bool allow_persistent)
+  : m_buffer(0), m_vertex_size(vertex_size), m_vertex_count(vertex_count),
+    m_persistent(allow_persistent && gl_ext.buffer_storage), m_slot(0), m_mapped(nullptr), m_fences{} {
+  const GLsizeiptr slot_bytes = vertex_size * vertex_count;
+  glGenBuffers(1, &m_buffer);
+  gl_state.bind_buffer(GL_ARRAY_BUFFER, m_buffer);
+  if (m_persistent) {
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    gl_ext.BufferStorage(GL_ARRAY_BUFFER, slot_bytes * num_slots, nullptr, flags);
+    m_mapped = static_cast<uint8_t*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, slot_bytes * num_slots, flags));
+    m_persistent = m_mapped != nullptr;
+  }
+  if (!m_persistent) {
+    glBufferData(GL_ARRAY_BUFFER, slot_bytes, nullptr, GL_STREAM_DRAW);
+    m_staging.resize(slot_bytes);
+  }
+}
+
+VertexStream::~VertexStream() {
+  for (GLsync fence : m_fences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  gl_state.bind_buffer(GL_ARRAY_BUFFER, m_buffer);
+  if (m_mapped) {
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  /* Unbound first so the state cache never holds a deleted name */
+  gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
+  glDeleteBuffers(1, &m_buffer);
+}
+
+void* VertexStream::acquire() {
+  if (!m_persistent) {
+    return m_staging.data();
+  }
+  /* Wait for the GPU to finish with the frame that last used this slot */
+  GLsync& fence = m_fences[m_slot];
+  if (fence) {
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+  return m_mapped + m_slot * m_vertex_size * m_vertex_count;
+}
+
+GLint VertexStream::submit() {
+  if (!m_persistent) {
+    const GLsizeiptr slot_bytes = m_vertex_size * m_vertex_count;
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, m_buffer);
+    glBufferData(GL_ARRAY_BUFFER, slot_bytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, slot_bytes, m_staging.data());
+    return 0;
+  }
+  return m_slot * m_vertex_count;
+}
+
+void VertexStream::fence() {
+  if (!m_persistent) {
+    return;
+  }
+  m_fences[m_slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_slot = (m_slot + 1) % num_slots;
+}
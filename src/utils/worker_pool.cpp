@@ -0,0 +1,73 @@
+#include <algorithm>
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(int threads)
+  : m_job(nullptr), m_count(0), m_next(0), m_running(0), m_generation(0), m_stop(false) {
+  if (threads <= 0) {
+    threads = std::max(1, int(std::thread::hardware_concurrency())) - 1;
+  }
+  for (int i = 0; i < threads; ++i) {
+    m_threads.emplace_back(&WorkerPool::work, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (std::thread& thread : m_threads) {
+    thread.join();
+  }
+}
+
+void WorkerPool::take_jobs() {
+  for (int i = m_next++; i < m_count; i = m_next++) {
+    (*m_job)(i);
+  }
+}
+
+void WorkerPool::work() {
+  unsigned int generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [&] { return m_stop || m_generation != generation; });
+      if (m_stop) {
+        return;
+      }
+      generation = m_generation;
+    }
+    take_jobs();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running -= 1;
+    }
+    m_done.notify_one();
+  }
+}
+
+void WorkerPool::run(int count, const std::function<void(int)>& job) {
+  if (m_threads.empty() || count <= 1) {
+    for (int i = 0; i < count; ++i) {
+      job(i);
+    }
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_job = &job;
+    m_count = count;
+    m_next = 0;
+    m_running = int(m_threads.size());
+    m_generation += 1;
+  }
+  m_wake.notify_all();
+  take_jobs();
+
+  /* Every worker checks in, so none is still reading this job afterwards */
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [&] { return m_running == 0; });
+  m_job = nullptr;
+}